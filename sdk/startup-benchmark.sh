@@ -0,0 +1,36 @@
+#!/usr/bin/env bash
+
+# Startup benchmark:
+# PEB is started several times, exits as soon as its first page is loaded and
+# the median of every startup phase is displayed.
+# Usage: startup-benchmark.sh [number of runs]
+
+cd .. || exit
+
+runs=${1:-10}
+
+if [ ! -x ./peb ]; then
+  printf "\\nPEB executable is not found in %s\\n" "$(pwd)"
+  exit 1
+fi
+
+results=$(mktemp)
+
+for ((run = 1; run <= runs; run++)); do
+  PEB_STARTUP_BENCHMARK=1 ./peb 2>&1 | grep "Startup latency" | tee -a "$results"
+done
+
+median () {
+  sort -n | awk '{ values[NR] = $1 } END { if (NR > 0) print values[int((NR + 1) / 2)] }'
+}
+
+printf "\\nMedian of %s runs:\\n" "$runs"
+printf "engine: %s ms\\n" "$(sed -n 's/.*engine \([0-9]*\) ms.*/\1/p' "$results" | median)"
+
+if grep -q "local server" "$results"; then
+  printf "local server: %s ms\\n" "$(sed -n 's/.*local server \([0-9]*\) ms.*/\1/p' "$results" | median)"
+fi
+
+printf "first page: %s ms\\n" "$(sed -n 's/.*first page \([0-9]*\) ms.*/\1/p' "$results" | median)"
+
+rm -f "$results"
@@ -0,0 +1,130 @@
+/*
+ Perl Executing Browser
+
+ This program is free software;
+ you can redistribute it and/or modify it under the terms of the
+ GNU Lesser General Public License,
+ as published by the Free Software Foundation;
+ either version 3 of the License, or (at your option) any later version.
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY;
+ without even the implied warranty of MERCHANTABILITY or
+ FITNESS FOR A PARTICULAR PURPOSE.
+ Dimitar D. Mitov, 2013 - 2019
+ Valcho Nedelchev, 2014 - 2016
+ https://github.com/ddmitov/perl-executing-browser
+*/
+
+#include <QtWidgets/QApplication>
+#include <QWindow>
+
+#ifdef Q_OS_LINUX
+#include <QDBusConnection>
+#endif
+
+#include "background-monitor.h"
+
+// ==============================
+// BACKGROUND MONITOR CONSTRUCTOR:
+// ==============================
+QBackgroundMonitor::QBackgroundMonitor(QWidget *monitoredWindow)
+    : QObject(monitoredWindow)
+{
+    window = monitoredWindow;
+    background = false;
+    screenLocked = false;
+    handleFiltered = false;
+
+    // Short periods in the background, like switching windows,
+    // do not change the state of the scripts:
+    backgroundDelay = new QTimer(this);
+    backgroundDelay->setSingleShot(true);
+    backgroundDelay->setInterval(2000);
+
+    QObject::connect(backgroundDelay, SIGNAL(timeout()),
+                     this, SLOT(qBackgroundDelaySlot()));
+
+    window->installEventFilter(this);
+
+    QObject::connect(qApp,
+                     SIGNAL(applicationStateChanged(Qt::ApplicationState)),
+                     this,
+                     SLOT(qApplicationStateSlot(Qt::ApplicationState)));
+
+#ifdef Q_OS_LINUX
+    // Screen lock notifications of freedesktop.org and GNOME desktops:
+    QDBusConnection::sessionBus().connect(
+                QString(),
+                "/org/freedesktop/ScreenSaver",
+                "org.freedesktop.ScreenSaver",
+                "ActiveChanged",
+                this,
+                SLOT(qScreenLockSlot(bool)));
+
+    QDBusConnection::sessionBus().connect(
+                QString(),
+                "/org/gnome/ScreenSaver",
+                "org.gnome.ScreenSaver",
+                "ActiveChanged",
+                this,
+                SLOT(qScreenLockSlot(bool)));
+#endif
+}
+
+// ==============================
+// Window state:
+// ==============================
+bool QBackgroundMonitor::eventFilter(QObject *object, QEvent *event)
+{
+    if (event->type() == QEvent::WindowStateChange or
+            event->type() == QEvent::Show or
+            event->type() == QEvent::Hide or
+            event->type() == QEvent::Expose) {
+        // Expose events are sent only to the native window,
+        // which exists after the window is shown for the first time:
+        if (handleFiltered == false and window->windowHandle() != NULL) {
+            window->windowHandle()->installEventFilter(this);
+            handleFiltered = true;
+        }
+
+        qCheckState();
+    }
+
+    return QObject::eventFilter(object, event);
+}
+
+bool QBackgroundMonitor::qWindowHidden()
+{
+    // Windows fully covered by other windows are not exposed
+    // on platforms reporting this:
+    bool exposed = true;
+
+    if (window->windowHandle() != NULL) {
+        exposed = window->windowHandle()->isExposed();
+    }
+
+    return screenLocked == true or
+            window->isVisible() == false or
+            window->isMinimized() == true or
+            exposed == false or
+            qApp->applicationState() == Qt::ApplicationHidden or
+            qApp->applicationState() == Qt::ApplicationSuspended;
+}
+
+void QBackgroundMonitor::qCheckState()
+{
+    if (qWindowHidden() == true) {
+        if (background == false and !backgroundDelay->isActive()) {
+            backgroundDelay->start();
+        }
+        return;
+    }
+
+    // A window coming back is handled immediately:
+    backgroundDelay->stop();
+
+    if (background == true) {
+        background = false;
+        emit backgroundChangedSignal(false);
+    }
+}
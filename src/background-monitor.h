@@ -0,0 +1,76 @@
+/*
+ Perl Executing Browser
+
+ This program is free software;
+ you can redistribute it and/or modify it under the terms of the
+ GNU Lesser General Public License,
+ as published by the Free Software Foundation;
+ either version 3 of the License, or (at your option) any later version.
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY;
+ without even the implied warranty of MERCHANTABILITY or
+ FITNESS FOR A PARTICULAR PURPOSE.
+ Dimitar D. Mitov, 2013 - 2019
+ Valcho Nedelchev, 2014 - 2016
+ https://github.com/ddmitov/perl-executing-browser
+*/
+
+#ifndef BACKGROUND_MONITOR_H
+#define BACKGROUND_MONITOR_H
+
+#include <QEvent>
+#include <QObject>
+#include <QTimer>
+#include <QWidget>
+
+// ==============================
+// BACKGROUND MONITOR CLASS DEFINITION:
+// Detects when a window can not be seen by the user
+// ==============================
+class QBackgroundMonitor : public QObject
+{
+    Q_OBJECT
+
+signals:
+    void backgroundChangedSignal(bool background);
+
+public slots:
+    void qScreenLockSlot(bool locked)
+    {
+        screenLocked = locked;
+        qCheckState();
+    }
+
+    void qApplicationStateSlot(Qt::ApplicationState state)
+    {
+        Q_UNUSED(state);
+        qCheckState();
+    }
+
+    void qBackgroundDelaySlot()
+    {
+        if (background == false and qWindowHidden() == true) {
+            background = true;
+            emit backgroundChangedSignal(true);
+        }
+    }
+
+public:
+    explicit QBackgroundMonitor(QWidget *monitoredWindow);
+
+    bool background;
+
+protected:
+    bool eventFilter(QObject *object, QEvent *event) override;
+
+private:
+    bool qWindowHidden();
+    void qCheckState();
+
+    QWidget *window;
+    QTimer *backgroundDelay;
+    bool screenLocked;
+    bool handleFiltered;
+};
+
+#endif // BACKGROUND_MONITOR_H
@@ -0,0 +1,523 @@
+/*
+ Perl Executing Browser
+
+ This program is free software;
+ you can redistribute it and/or modify it under the terms of the
+ GNU Lesser General Public License,
+ as published by the Free Software Foundation;
+ either version 3 of the License, or (at your option) any later version.
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY;
+ without even the implied warranty of MERCHANTABILITY or
+ FITNESS FOR A PARTICULAR PURPOSE.
+ Dimitar D. Mitov, 2013 - 2019
+ Valcho Nedelchev, 2014 - 2016
+ https://github.com/ddmitov/perl-executing-browser
+*/
+
+#include <QtGlobal>
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+
+#include <cmath>
+
+#ifndef Q_OS_WIN
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+#ifdef Q_OS_LINUX
+#include <sys/syscall.h>
+#endif
+
+#include "child-process.h"
+
+// ==============================
+// CHILD PROCESS CONSTRUCTOR:
+// ==============================
+QChildProcess::QChildProcess(QObject *parent)
+    : QProcess(parent)
+{
+    inheritedSocket = -1;
+    inheritedSocketTarget = 3;
+    newProcessGroup = false;
+
+    memoryLimit = 0;
+    cpuWeight = 0;
+    niceLevel = 0;
+    ioPriorityClass = 0;
+    ioPriorityLevel = 0;
+
+    memoryControlled = false;
+    cpuControlled = false;
+    cpuNiceLevel = 0;
+
+    userCpuTime = 0;
+    systemCpuTime = 0;
+    peakMemory = 0;
+}
+
+// ==============================
+// Process group signals:
+// There are no process groups on Windows and
+// only the child itself is stopped there.
+// ==============================
+void QChildProcess::terminateProcessGroup()
+{
+    if (state() == QProcess::NotRunning) {
+        return;
+    }
+
+#ifndef Q_OS_WIN
+    // The process group may not exist yet if
+    // the child has not reached setupChildProcess().
+    // Processes stopped by throttling must be continued
+    // to handle the termination signal:
+    if (newProcessGroup == true and ::kill(-processId(), SIGTERM) == 0) {
+        ::kill(-processId(), SIGCONT);
+        return;
+    }
+
+    terminate();
+    ::kill(processId(), SIGCONT);
+#endif
+
+#ifdef Q_OS_WIN
+    kill();
+#endif
+}
+
+void QChildProcess::killProcessGroup()
+{
+    if (state() == QProcess::NotRunning) {
+        return;
+    }
+
+#ifndef Q_OS_WIN
+    if (newProcessGroup == true and ::kill(-processId(), SIGKILL) == 0) {
+        return;
+    }
+#endif
+
+    kill();
+}
+
+bool QChildProcess::stopProcessGroup()
+{
+#ifndef Q_OS_WIN
+    if (state() == QProcess::Running and newProcessGroup == true) {
+        return ::kill(-processId(), SIGSTOP) == 0;
+    }
+#endif
+
+    return false;
+}
+
+void QChildProcess::continueProcessGroup()
+{
+#ifndef Q_OS_WIN
+    if (state() == QProcess::Running and newProcessGroup == true) {
+        ::kill(-processId(), SIGCONT);
+    }
+#endif
+}
+
+#ifdef Q_OS_LINUX
+// ==============================
+// Control groups:
+// ==============================
+static bool writeControlFile(QString fileName, QByteArray value)
+{
+    QFile controlFile(fileName);
+
+    if (!controlFile.open(QIODevice::WriteOnly | QIODevice::Unbuffered)) {
+        return false;
+    }
+
+    return controlFile.write(value) == value.length();
+}
+
+// A process belongs to PEB if it is PEB itself or one of its descendants:
+static bool isOwnProcess(QByteArray process)
+{
+    qint64 ownPid = QCoreApplication::applicationPid();
+    qint64 pid = process.toLongLong();
+
+    while (pid > 1) {
+        if (pid == ownPid) {
+            return true;
+        }
+
+        QFile processStatus("/proc/" + QString::number(pid) + "/stat");
+
+        if (!processStatus.open(QIODevice::ReadOnly)) {
+            return false;
+        }
+
+        // The parent process ID is the second field after
+        // the command name, which is enclosed in parentheses:
+        QByteArray status = processStatus.readAll();
+        QList<QByteArray> fields =
+                status.mid(status.lastIndexOf(')') + 2).split(' ');
+
+        if (fields.length() < 2) {
+            return false;
+        }
+
+        pid = fields[1].toLongLong();
+    }
+
+    return false;
+}
+
+// Control group v2 of the browser holding the control groups of scripts.
+// Controllers can be enabled only for control groups without processes,
+// so all processes of the browser control group are moved to
+// a leaf control group when the first script is started.
+// This is done only if PEB has a dedicated control group,
+// for example a systemd scope, and no other process is moved.
+static QString scriptsControlGroup(bool &memoryController,
+                                   bool &cpuController)
+{
+    static bool initialized = false;
+    static QString controlGroup;
+    static bool memoryAvailable = false;
+    static bool cpuAvailable = false;
+
+    if (initialized == false) {
+        initialized = true;
+
+        QString ownControlGroup;
+        QFile processControlGroups("/proc/self/cgroup");
+
+        if (processControlGroups.open(QIODevice::ReadOnly)) {
+            foreach (QByteArray line,
+                     processControlGroups.readAll().split('\n')) {
+                if (line.startsWith("0::")) {
+                    ownControlGroup = "/sys/fs/cgroup" +
+                            QString::fromUtf8(line.mid(3)).trimmed();
+                }
+            }
+        }
+
+        QList<QByteArray> ownProcesses;
+        bool dedicatedControlGroup = false;
+
+        if (ownControlGroup.length() > 0 and
+                QFile::exists(ownControlGroup + "/cgroup.controllers")) {
+            QFile processes(ownControlGroup + "/cgroup.procs");
+
+            if (processes.open(QIODevice::ReadOnly)) {
+                dedicatedControlGroup = true;
+
+                foreach (QByteArray process, processes.readAll().split('\n')) {
+                    if (process.length() == 0) {
+                        continue;
+                    }
+
+                    if (!isOwnProcess(process)) {
+                        dedicatedControlGroup = false;
+                        break;
+                    }
+
+                    ownProcesses.append(process);
+                }
+            }
+        }
+
+        if (dedicatedControlGroup == true) {
+            QString browserControlGroup = ownControlGroup + "/peb-browser";
+            QDir().mkdir(browserControlGroup);
+
+            foreach (QByteArray process, ownProcesses) {
+                writeControlFile(browserControlGroup + "/cgroup.procs",
+                                 process);
+            }
+
+            writeControlFile(ownControlGroup + "/cgroup.subtree_control",
+                             "+memory");
+            writeControlFile(ownControlGroup + "/cgroup.subtree_control",
+                             "+cpu");
+
+            QFile subtreeControl(ownControlGroup + "/cgroup.subtree_control");
+
+            if (subtreeControl.open(QIODevice::ReadOnly)) {
+                QList<QByteArray> controllers =
+                        subtreeControl.readAll().simplified().split(' ');
+
+                memoryAvailable = controllers.contains("memory");
+                cpuAvailable = controllers.contains("cpu");
+            }
+
+            if (memoryAvailable == true or cpuAvailable == true) {
+                controlGroup = ownControlGroup;
+            }
+        }
+    }
+
+    memoryController = memoryAvailable;
+    cpuController = cpuAvailable;
+
+    return controlGroup;
+}
+#endif
+
+// ==============================
+// Resource limits:
+// Control groups v2 are used on Linux if they are delegated to the user.
+// setrlimit(), nice() and ioprio_set() are used otherwise.
+// There are no resource limits on Windows.
+// ==============================
+void QChildProcess::prepareResourceLimits()
+{
+    releaseResourceLimits();
+
+    memoryControlled = false;
+    cpuControlled = false;
+
+#ifdef Q_OS_LINUX
+    if (memoryLimit > 0 or cpuWeight > 0) {
+        bool memoryController = false;
+        bool cpuController = false;
+
+        QString parentControlGroup =
+                scriptsControlGroup(memoryController, cpuController);
+
+        static int controlGroupNumber = 0;
+
+        if (parentControlGroup.length() > 0) {
+            controlGroupNumber++;
+
+            controlGroup = parentControlGroup + "/peb-script-" +
+                    QString::number(QCoreApplication::applicationPid()) +
+                    "-" + QString::number(controlGroupNumber);
+
+            if (QDir().mkdir(controlGroup)) {
+                if (memoryLimit > 0 and memoryController == true) {
+                    memoryControlled =
+                            writeControlFile(controlGroup + "/memory.max",
+                                             QByteArray::number(memoryLimit));
+
+                    // The memory limit is not circumvented by swapping:
+                    writeControlFile(controlGroup + "/memory.swap.max", "0");
+                }
+
+                if (cpuWeight > 0 and cpuController == true) {
+                    cpuControlled =
+                            writeControlFile(
+                                controlGroup + "/cpu.weight",
+                                QByteArray::number(
+                                    qBound(1, cpuWeight, 10000)));
+                }
+
+                controlGroupProcesses =
+                        QFile::encodeName(controlGroup + "/cgroup.procs");
+            } else {
+                controlGroup.clear();
+            }
+        }
+    }
+#endif
+
+    // Without the cpu controller a CPU share below the default
+    // becomes a nice level. The default share of 100 is nice level 0 and
+    // every nice level changes the share by about 25 percent:
+    cpuNiceLevel = 0;
+
+    if (cpuWeight > 0 and cpuWeight < 100) {
+        cpuNiceLevel = qBound(
+                    0,
+                    int(std::floor(std::log(100.0 / cpuWeight) /
+                                   std::log(1.25) + 0.5)),
+                    19);
+    }
+}
+
+QString QChildProcess::resourceLimitsReport()
+{
+    QString report;
+
+#ifdef Q_OS_LINUX
+    if (memoryControlled == true) {
+        QFile memoryEvents(controlGroup + "/memory.events");
+
+        if (memoryEvents.open(QIODevice::ReadOnly)) {
+            foreach (QByteArray line, memoryEvents.readAll().split('\n')) {
+                if (line.startsWith("oom_kill ") and
+                        line.mid(9).toLongLong() > 0) {
+                    report = "Memory limit of " +
+                            QString::number(memoryLimit / (1024 * 1024)) +
+                            " MB is reached and " +
+                            QString::fromLatin1(line.mid(9)) +
+                            " process(es) killed.";
+                }
+            }
+        }
+    }
+#endif
+
+    return report;
+}
+
+// ==============================
+// Resource usage:
+// ==============================
+void QChildProcess::sampleResourceUsage()
+{
+#ifdef Q_OS_LINUX
+    // A control group counts all descendants of the child and
+    // is readable until it is released after the child has finished:
+    if (controlGroup.length() > 0) {
+        QFile cpuStat(controlGroup + "/cpu.stat");
+
+        if (cpuStat.open(QIODevice::ReadOnly)) {
+            foreach (QByteArray line, cpuStat.readAll().split('\n')) {
+                if (line.startsWith("user_usec ")) {
+                    userCpuTime = line.mid(10).toLongLong() / 1000;
+                }
+
+                if (line.startsWith("system_usec ")) {
+                    systemCpuTime = line.mid(12).toLongLong() / 1000;
+                }
+            }
+        }
+
+        // memory.peak is available since Linux 5.19:
+        QFile memoryPeak(controlGroup + "/memory.peak");
+
+        if (memoryPeak.open(QIODevice::ReadOnly)) {
+            peakMemory = qMax(peakMemory,
+                              memoryPeak.readAll().trimmed().toLongLong());
+        }
+
+        return;
+    }
+
+    if (state() != QProcess::Running) {
+        return;
+    }
+
+    QString processDirectory = "/proc/" + QString::number(processId());
+
+    // CPU times are the 14th and 15th fields of the process status and
+    // all fields after the command name are separated by spaces:
+    QFile processStat(processDirectory + "/stat");
+
+    if (processStat.open(QIODevice::ReadOnly)) {
+        QByteArray stat = processStat.readAll();
+        QList<QByteArray> fields =
+                stat.mid(stat.lastIndexOf(')') + 2).split(' ');
+
+        if (fields.length() > 12) {
+            long ticks = sysconf(_SC_CLK_TCK);
+
+            if (ticks > 0) {
+                userCpuTime = fields[11].toLongLong() * 1000 / ticks;
+                systemCpuTime = fields[12].toLongLong() * 1000 / ticks;
+            }
+        }
+    }
+
+    QFile processStatus(processDirectory + "/status");
+
+    if (processStatus.open(QIODevice::ReadOnly)) {
+        foreach (QByteArray line, processStatus.readAll().split('\n')) {
+            if (line.startsWith("VmHWM:")) {
+                qint64 kilobytes =
+                        line.mid(6).replace("kB", "").trimmed().toLongLong();
+                peakMemory = qMax(peakMemory, kilobytes * 1024);
+            }
+        }
+    }
+#endif
+}
+
+void QChildProcess::releaseResourceLimits()
+{
+    // A control group can be removed only after
+    // all its processes have finished:
+    if (controlGroup.length() > 0) {
+        QDir().rmdir(controlGroup);
+        controlGroup.clear();
+        controlGroupProcesses.clear();
+    }
+}
+
+#ifndef Q_OS_WIN
+// ==============================
+// Child setup between fork and exec:
+// Only async-signal-safe calls are allowed here.
+// ==============================
+void QChildProcess::setupChildProcess()
+{
+    if (newProcessGroup == true) {
+        setpgid(0, 0);
+    }
+
+    // The child joins its control group and
+    // the fallback limits are set if this is not possible:
+    bool controlGroupJoined = false;
+
+    if (controlGroupProcesses.length() > 0) {
+        int controlFile = open(controlGroupProcesses.constData(), O_WRONLY);
+
+        if (controlFile >= 0) {
+            controlGroupJoined = (write(controlFile, "0", 1) == 1);
+            close(controlFile);
+        }
+    }
+
+    if (memoryLimit > 0 and
+            (controlGroupJoined == false or memoryControlled == false)) {
+        struct rlimit addressSpaceLimit;
+        addressSpaceLimit.rlim_cur = memoryLimit;
+        addressSpaceLimit.rlim_max = memoryLimit;
+        setrlimit(RLIMIT_AS, &addressSpaceLimit);
+    }
+
+    int childNiceLevel = niceLevel;
+
+    if (childNiceLevel == 0 and
+            (controlGroupJoined == false or cpuControlled == false)) {
+        childNiceLevel = cpuNiceLevel;
+    }
+
+    if (childNiceLevel > 0) {
+        // nice() can return -1 as a valid nice level,
+        // so its errors are recognized only by errno.
+        // write() is used, because it is async-signal-safe:
+        errno = 0;
+
+        if (nice(childNiceLevel) == -1 and errno != 0) {
+            static const char niceError[] =
+                    "PEB: the CPU share of the script could not be set.\n";
+            ssize_t written = write(STDERR_FILENO,
+                                    niceError, sizeof(niceError) - 1);
+            Q_UNUSED(written);
+        }
+    }
+
+#ifdef Q_OS_LINUX
+    if (ioPriorityClass > 0) {
+        // IOPRIO_WHO_PROCESS and IOPRIO_PRIO_VALUE():
+        syscall(SYS_ioprio_set, 1, 0,
+                (ioPriorityClass << 13) | ioPriorityLevel);
+    }
+#endif
+
+    if (inheritedSocket >= 0) {
+        // dup2() clears the close-on-exec flag of the new descriptor,
+        // but it does nothing if the socket already has the target number:
+        if (inheritedSocket == inheritedSocketTarget) {
+            fcntl(inheritedSocketTarget, F_SETFD, 0);
+        } else {
+            dup2(inheritedSocket, inheritedSocketTarget);
+        }
+    }
+}
+#endif
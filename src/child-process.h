@@ -0,0 +1,87 @@
+/*
+ Perl Executing Browser
+
+ This program is free software;
+ you can redistribute it and/or modify it under the terms of the
+ GNU Lesser General Public License,
+ as published by the Free Software Foundation;
+ either version 3 of the License, or (at your option) any later version.
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY;
+ without even the implied warranty of MERCHANTABILITY or
+ FITNESS FOR A PARTICULAR PURPOSE.
+ Dimitar D. Mitov, 2013 - 2019
+ Valcho Nedelchev, 2014 - 2016
+ https://github.com/ddmitov/perl-executing-browser
+*/
+
+#ifndef CHILD_PROCESS_H
+#define CHILD_PROCESS_H
+
+#include <QProcess>
+
+// ==============================
+// CHILD PROCESS CLASS DEFINITION:
+// QProcess with child setup between fork and exec on Unix systems
+// ==============================
+class QChildProcess : public QProcess
+{
+    Q_OBJECT
+
+public:
+    explicit QChildProcess(QObject *parent = 0);
+
+    // Listening socket passed to the child.
+    // It becomes file descriptor 3 with the systemd socket activation
+    // protocol by default or file descriptor 0 for FastCGI workers:
+    int inheritedSocket;
+    int inheritedSocketTarget;
+
+    // The child leads a new process group holding all its descendants,
+    // so that they can be signalled together:
+    bool newProcessGroup;
+
+    void terminateProcessGroup();
+    void killProcessGroup();
+
+    // Pausing and resuming of the process group.
+    // Processes can not be paused on Windows:
+    bool stopProcessGroup();
+    void continueProcessGroup();
+
+    // Resource limits of the child.
+    // Zero values keep the limits inherited from the browser:
+    qint64 memoryLimit;     // bytes
+    int cpuWeight;          // 1 - 10000, 100 is the default CPU share
+    int niceLevel;          // 0 - 19
+    int ioPriorityClass;    // 2 - best effort, 3 - idle
+    int ioPriorityLevel;    // 0 - 7
+
+    // Resource limits are prepared before every start and
+    // released after the child has finished:
+    void prepareResourceLimits();
+    QString resourceLimitsReport();
+    void releaseResourceLimits();
+
+    // Resource usage of the child, read from its control group or
+    // sampled from /proc while it is running on Linux.
+    // CPU times are in milliseconds and the peak memory is in bytes:
+    void sampleResourceUsage();
+    qint64 userCpuTime;
+    qint64 systemCpuTime;
+    qint64 peakMemory;
+
+#ifndef Q_OS_WIN
+protected:
+    void setupChildProcess() override;
+#endif
+
+private:
+    QString controlGroup;
+    QByteArray controlGroupProcesses;
+    bool memoryControlled;
+    bool cpuControlled;
+    int cpuNiceLevel;
+};
+
+#endif // CHILD_PROCESS_H
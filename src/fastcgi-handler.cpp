@@ -0,0 +1,514 @@
+/*
+ Perl Executing Browser
+
+ This program is free software;
+ you can redistribute it and/or modify it under the terms of the
+ GNU Lesser General Public License,
+ as published by the Free Software Foundation;
+ either version 3 of the License, or (at your option) any later version.
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY;
+ without even the implied warranty of MERCHANTABILITY or
+ FITNESS FOR A PARTICULAR PURPOSE.
+ Dimitar D. Mitov, 2013 - 2019
+ Valcho Nedelchev, 2014 - 2016
+ https://github.com/ddmitov/perl-executing-browser
+*/
+
+#include <QBuffer>
+#include <QDir>
+#include <QMap>
+#include <QUrl>
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "fastcgi-handler.h"
+
+// FastCGI protocol constants:
+#define FCGI_VERSION_1 1
+#define FCGI_BEGIN_REQUEST 1
+#define FCGI_END_REQUEST 3
+#define FCGI_PARAMS 4
+#define FCGI_STDIN 5
+#define FCGI_STDOUT 6
+#define FCGI_STDERR 7
+#define FCGI_RESPONDER 1
+
+// ==============================
+// FastCGI record helpers:
+// ==============================
+static QByteArray fastCgiRecord(int type, QByteArray content)
+{
+    QByteArray record;
+    int padding = (8 - (content.length() % 8)) % 8;
+
+    record.append(char(FCGI_VERSION_1));
+    record.append(char(type));
+    record.append(char(0));
+    record.append(char(1)); // Request ID - one request per connection
+    record.append(char((content.length() >> 8) & 0xFF));
+    record.append(char(content.length() & 0xFF));
+    record.append(char(padding));
+    record.append(char(0));
+    record.append(content);
+    record.append(QByteArray(padding, '\0'));
+
+    return record;
+}
+
+static void fastCgiLength(QByteArray &pairs, int length)
+{
+    if (length < 128) {
+        pairs.append(char(length));
+    } else {
+        pairs.append(char(((length >> 24) & 0x7F) | 0x80));
+        pairs.append(char((length >> 16) & 0xFF));
+        pairs.append(char((length >> 8) & 0xFF));
+        pairs.append(char(length & 0xFF));
+    }
+}
+
+static void fastCgiParameter(QByteArray &pairs,
+                             QByteArray name,
+                             QByteArray value)
+{
+    fastCgiLength(pairs, name.length());
+    fastCgiLength(pairs, value.length());
+    pairs.append(name);
+    pairs.append(value);
+}
+
+// ==============================
+// FASTCGI HANDLER CONSTRUCTOR:
+// ==============================
+QFastCgiHandler::QFastCgiHandler(QStringList workerArguments,
+                                 int minimumWorkerCount,
+                                 int maximumWorkerCount,
+                                 int workerIdleTimeout,
+                                 QFile *logFile)
+    : QWebEngineUrlSchemeHandler(0),
+      socketDirectory(QDir::tempPath() + "/peb-XXXXXX")
+{
+    arguments = workerArguments;
+    minimumWorkers = minimumWorkerCount;
+    maximumWorkers = maximumWorkerCount;
+    idleTimeout = workerIdleTimeout;
+    log = logFile;
+
+    responseCache = NULL;
+
+    workerNumber = 0;
+    stopping = false;
+
+    poolClock.start();
+
+    poolMaintenanceTimer = new QTimer(this);
+    QObject::connect(poolMaintenanceTimer, SIGNAL(timeout()),
+                     this, SLOT(qPoolMaintenanceSlot()));
+    poolMaintenanceTimer->start(1000);
+
+    qPoolMaintenanceSlot();
+}
+
+// ==============================
+// Request entry point:
+// ==============================
+void QFastCgiHandler::requestStarted(QWebEngineUrlRequestJob *job)
+{
+    job->setProperty("startTime", poolClock.nsecsElapsed());
+
+#if QT_VERSION < QT_VERSION_CHECK(5, 15, 0)
+    // Request bodies are available only since Qt 5.15 and
+    // requests with a body are rejected instead of being sent empty:
+    if (job->requestMethod() != "GET" and job->requestMethod() != "HEAD") {
+        if (log != NULL) {
+            log->write("Request method " + job->requestMethod() +
+                       " is not supported by this Qt version.\n");
+            log->flush();
+        }
+
+        job->fail(QWebEngineUrlRequestJob::RequestDenied);
+        return;
+    }
+#endif
+
+    // Fresh cached responses are served without a worker:
+    QCachedResponse cachedResponse;
+
+    if (responseCache != NULL and
+            job->requestMethod() == "GET" and
+            responseCache->qLookup(job->requestUrl(), cachedResponse) and
+            cachedResponse.expirationDate > QDateTime::currentDateTimeUtc()) {
+        responseCache->hits++;
+        qReplyData(job, cachedResponse.contentType, cachedResponse.body);
+
+        QRequestStatistics::instance()->qRecord(
+                    QString::fromLatin1(job->requestMethod()),
+                    job->requestUrl(),
+                    0,
+                    (poolClock.nsecsElapsed() -
+                     job->property("startTime").toLongLong()) / 1000,
+                    cachedResponse.body.size());
+        return;
+    }
+
+    pendingJobs.append(QPointer<QWebEngineUrlRequestJob>(job));
+    qDispatchSlot();
+}
+
+// ==============================
+// Worker pool:
+// ==============================
+QChildProcess *QFastCgiHandler::qIdleWorker()
+{
+    foreach (QChildProcess *worker, workers) {
+        if (worker->property("busy").toBool() == false and
+                worker->property("retiring").toBool() == false) {
+            return worker;
+        }
+    }
+
+    return NULL;
+}
+
+QChildProcess *QFastCgiHandler::qStartWorker()
+{
+    if (stopping == true or !socketDirectory.isValid()) {
+        return NULL;
+    }
+
+    workerNumber++;
+
+    QString socketPath = socketDirectory.path() + "/worker-" +
+            QString::number(workerNumber) + ".sock";
+
+    // The listening socket is created by the browser and
+    // inherited by the worker as file descriptor 0,
+    // so requests can be sent before the worker has started and
+    // wait in the socket backlog:
+    QByteArray socketPathBytes = QFile::encodeName(socketPath);
+
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+
+    if (socketPathBytes.length() >= (int) sizeof(address.sun_path)) {
+        return NULL;
+    }
+
+    memcpy(address.sun_path,
+           socketPathBytes.constData(),
+           socketPathBytes.length());
+
+    int listeningSocket = ::socket(AF_UNIX, SOCK_STREAM, 0);
+
+    if (listeningSocket < 0) {
+        return NULL;
+    }
+
+    fcntl(listeningSocket, F_SETFD, FD_CLOEXEC);
+
+    if (::bind(listeningSocket,
+               (struct sockaddr *) &address,
+               sizeof(address)) < 0 or
+            ::listen(listeningSocket, 16) < 0) {
+        ::close(listeningSocket);
+        return NULL;
+    }
+
+    QChildProcess *worker = new QChildProcess(this);
+    worker->setProcessChannelMode(QProcess::MergedChannels);
+    worker->newProcessGroup = true;
+    worker->inheritedSocket = listeningSocket;
+    worker->inheritedSocketTarget = 0;
+
+    worker->setProperty("socketPath", socketPath);
+    worker->setProperty("busy", false);
+    worker->setProperty("retiring", false);
+    worker->setProperty("idleSince", poolClock.elapsed());
+
+    QObject::connect(worker, SIGNAL(readyReadStandardOutput()),
+                     this, SLOT(qWorkerOutputSlot()));
+
+    QObject::connect(worker, SIGNAL(finished(int, QProcess::ExitStatus)),
+                     this, SLOT(qWorkerFinishedSlot()));
+
+    QObject::connect(worker, SIGNAL(error(QProcess::ProcessError)),
+                     this, SLOT(qWorkerErrorSlot(QProcess::ProcessError)));
+
+    // The worker is added to the pool before start(),
+    // because a start failure can be reported from start():
+    workers.append(worker);
+
+    worker->start(qApp->property("perlInterpreter").toString(), arguments);
+
+    // The worker has its own copy of the listening socket after start():
+    ::close(listeningSocket);
+
+    if (!workers.contains(worker)) {
+        return NULL;
+    }
+
+    return worker;
+}
+
+// ==============================
+// FastCGI request:
+// ==============================
+QByteArray QFastCgiHandler::qFastCgiRequest(QWebEngineUrlRequestJob *job)
+{
+    QUrl url = job->requestUrl();
+
+    QByteArray beginRequest;
+    beginRequest.append(char(0));
+    beginRequest.append(char(FCGI_RESPONDER));
+    beginRequest.append(QByteArray(6, '\0'));
+
+    QByteArray requestUri = url.path(QUrl::FullyEncoded).toLatin1();
+    if (url.hasQuery()) {
+        requestUri.append("?");
+        requestUri.append(url.query(QUrl::FullyEncoded).toLatin1());
+    }
+
+    QByteArray pairs;
+    fastCgiParameter(pairs, "GATEWAY_INTERFACE", "CGI/1.1");
+    fastCgiParameter(pairs, "SERVER_SOFTWARE",
+                     "PEB/" + qApp->applicationVersion().toLatin1());
+    fastCgiParameter(pairs, "SERVER_PROTOCOL", "HTTP/1.1");
+    fastCgiParameter(pairs, "SERVER_NAME", url.host().toLatin1());
+    fastCgiParameter(pairs, "SERVER_PORT", "80");
+    fastCgiParameter(pairs, "REMOTE_ADDR", "127.0.0.1");
+    fastCgiParameter(pairs, "REQUEST_METHOD", job->requestMethod());
+    fastCgiParameter(pairs, "REQUEST_URI", requestUri);
+    fastCgiParameter(pairs, "SCRIPT_NAME", "");
+    fastCgiParameter(pairs, "PATH_INFO", url.path().toUtf8());
+    fastCgiParameter(pairs, "QUERY_STRING",
+                     url.query(QUrl::FullyEncoded).toLatin1());
+    fastCgiParameter(pairs, "HTTP_HOST", url.host().toLatin1());
+
+    QByteArray requestBody;
+
+#if QT_VERSION >= QT_VERSION_CHECK(5, 15, 0)
+    if (job->requestBody() != NULL) {
+        requestBody = job->requestBody()->readAll();
+    }
+
+    // Request headers are passed as CGI meta-variables:
+    QMap<QByteArray, QByteArray> requestHeaders = job->requestHeaders();
+
+    foreach (QByteArray name, requestHeaders.keys()) {
+        QByteArray variable = name.toUpper().replace('-', '_');
+
+        if (variable == "CONTENT_TYPE") {
+            fastCgiParameter(pairs, "CONTENT_TYPE", requestHeaders[name]);
+        } else if (variable != "HOST" and variable != "CONTENT_LENGTH") {
+            fastCgiParameter(pairs, "HTTP_" + variable, requestHeaders[name]);
+        }
+    }
+#endif
+
+    fastCgiParameter(pairs, "CONTENT_LENGTH",
+                     QByteArray::number(requestBody.length()));
+
+    // Stale cached responses are revalidated using their validators:
+    QCachedResponse cachedResponse;
+
+    if (responseCache != NULL and
+            job->requestMethod() == "GET" and
+            responseCache->qLookup(url, cachedResponse)) {
+        if (!cachedResponse.entityTag.isEmpty()) {
+            fastCgiParameter(pairs, "HTTP_IF_NONE_MATCH",
+                             cachedResponse.entityTag);
+        }
+
+        if (!cachedResponse.lastModified.isEmpty()) {
+            fastCgiParameter(pairs, "HTTP_IF_MODIFIED_SINCE",
+                             cachedResponse.lastModified);
+        }
+    }
+
+    QByteArray request;
+    request.append(fastCgiRecord(FCGI_BEGIN_REQUEST, beginRequest));
+
+    // Parameters longer than the maximal record length are split:
+    for (int offset = 0; offset < pairs.length(); offset += 65535) {
+        request.append(fastCgiRecord(FCGI_PARAMS, pairs.mid(offset, 65535)));
+    }
+
+    request.append(fastCgiRecord(FCGI_PARAMS, QByteArray()));
+
+    for (int offset = 0; offset < requestBody.length(); offset += 65535) {
+        request.append(fastCgiRecord(FCGI_STDIN,
+                                     requestBody.mid(offset, 65535)));
+    }
+
+    request.append(fastCgiRecord(FCGI_STDIN, QByteArray()));
+
+    return request;
+}
+
+// ==============================
+// FastCGI response:
+// ==============================
+int QFastCgiHandler::qReply(QWebEngineUrlRequestJob *job,
+                            QByteArray response)
+{
+    QByteArray output;
+    bool requestEnded = false;
+    int offset = 0;
+
+    while (offset + 8 <= response.length()) {
+        int type = (unsigned char) response[offset + 1];
+        int contentLength =
+                ((unsigned char) response[offset + 4] << 8) |
+                (unsigned char) response[offset + 5];
+        int paddingLength = (unsigned char) response[offset + 6];
+
+        if (offset + 8 + contentLength > response.length()) {
+            break;
+        }
+
+        QByteArray content = response.mid(offset + 8, contentLength);
+
+        if (type == FCGI_STDOUT) {
+            output.append(content);
+        }
+
+        if (type == FCGI_STDERR and log != NULL) {
+            log->write(content);
+            log->flush();
+        }
+
+        if (type == FCGI_END_REQUEST) {
+            requestEnded = true;
+        }
+
+        offset = offset + 8 + contentLength + paddingLength;
+    }
+
+    if (requestEnded == false) {
+        job->fail(QWebEngineUrlRequestJob::RequestFailed);
+        return 0;
+    }
+
+    // CGI response headers are separated from the body by an empty line:
+    int headersEnd = output.indexOf("\r\n\r\n");
+    int separatorLength = 4;
+
+    if (headersEnd < 0) {
+        headersEnd = output.indexOf("\n\n");
+        separatorLength = 2;
+    }
+
+    if (headersEnd < 0) {
+        job->fail(QWebEngineUrlRequestJob::RequestFailed);
+        return 0;
+    }
+
+    QByteArray contentType = "text/html";
+    QByteArray location;
+    QList<QPair<QByteArray, QByteArray> > headers;
+    int status = 200;
+
+    foreach (QByteArray header, output.left(headersEnd).split('\n')) {
+        int colon = header.indexOf(':');
+
+        if (colon > 0) {
+            QByteArray name = header.left(colon).trimmed().toLower();
+            QByteArray value = header.mid(colon + 1).trimmed();
+
+            headers.append(qMakePair(name, value));
+
+            if (name == "content-type") {
+                contentType = value;
+            }
+
+            if (name == "location") {
+                location = value;
+            }
+
+            if (name == "status") {
+                status = value.left(3).toInt();
+            }
+        }
+    }
+
+    if (location.length() > 0 and (status == 200 or status / 100 == 3)) {
+        job->redirect(job->requestUrl().resolved(
+                          QUrl::fromEncoded(location)));
+        return 0;
+    }
+
+    QByteArray body = output.mid(headersEnd + separatorLength);
+
+    // Error statuses are reported to the browser engine as failed jobs
+    // and a Not Modified status is valid only for a cached response:
+    if (status / 100 != 2 and status != 304) {
+        QWebEngineUrlRequestJob::Error error =
+                QWebEngineUrlRequestJob::RequestFailed;
+
+        if (status == 404 or status == 410) {
+            error = QWebEngineUrlRequestJob::UrlNotFound;
+        }
+
+        if (status == 401 or status == 403) {
+            error = QWebEngineUrlRequestJob::RequestDenied;
+        }
+
+        job->fail(error);
+        return 0;
+    }
+
+    // Only complete responses to GET requests are cached and
+    // a cached response confirmed by the worker is used again:
+    if (responseCache != NULL and job->requestMethod() == "GET") {
+        QCachedResponse cachedResponse;
+
+        if (status == 304 and
+                responseCache->qLookup(job->requestUrl(), cachedResponse)) {
+            QCachedResponse validatedResponse;
+            QResponseCache::qCacheable(headers, validatedResponse);
+
+            responseCache->revalidations++;
+            responseCache->qRefresh(job->requestUrl(),
+                                    validatedResponse.expirationDate);
+
+            qReplyData(job, cachedResponse.contentType, cachedResponse.body);
+            return cachedResponse.body.size();
+        }
+
+        responseCache->misses++;
+
+        cachedResponse.contentType = contentType;
+        cachedResponse.body = body;
+
+        if (status == 200 and
+                QResponseCache::qCacheable(headers, cachedResponse)) {
+            responseCache->qStore(job->requestUrl(), cachedResponse);
+        }
+    }
+
+    if (status == 304) {
+        job->fail(QWebEngineUrlRequestJob::RequestFailed);
+        return 0;
+    }
+
+    qReplyData(job, contentType, body);
+
+    return body.size();
+}
+
+void QFastCgiHandler::qReplyData(QWebEngineUrlRequestJob *job,
+                                 QByteArray contentType,
+                                 QByteArray data)
+{
+    // The buffer is deleted together with the job:
+    QBuffer *body = new QBuffer(job);
+    body->setData(data);
+
+    job->reply(contentType, body);
+}
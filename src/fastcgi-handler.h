@@ -0,0 +1,321 @@
+/*
+ Perl Executing Browser
+
+ This program is free software;
+ you can redistribute it and/or modify it under the terms of the
+ GNU Lesser General Public License,
+ as published by the Free Software Foundation;
+ either version 3 of the License, or (at your option) any later version.
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY;
+ without even the implied warranty of MERCHANTABILITY or
+ FITNESS FOR A PARTICULAR PURPOSE.
+ Dimitar D. Mitov, 2013 - 2019
+ Valcho Nedelchev, 2014 - 2016
+ https://github.com/ddmitov/perl-executing-browser
+*/
+
+#ifndef FASTCGI_HANDLER_H
+#define FASTCGI_HANDLER_H
+
+#include <QApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QHash>
+#include <QList>
+#include <QLocalSocket>
+#include <QPointer>
+#include <QTemporaryDir>
+#include <QTimer>
+#include <QWebEngineUrlRequestJob>
+#include <QWebEngineUrlSchemeHandler>
+
+#include "child-process.h"
+#include "request-statistics.h"
+#include "response-cache.h"
+
+// ==============================
+// FASTCGI HANDLER CLASS DEFINITION:
+// URL scheme handler speaking FastCGI with
+// a pool of Perl workers on Unix domain sockets
+// ==============================
+class QFastCgiHandler : public QWebEngineUrlSchemeHandler
+{
+    Q_OBJECT
+
+public slots:
+    // ==============================
+    // Requests:
+    // ==============================
+    void qDispatchSlot()
+    {
+        while (!pendingJobs.isEmpty()) {
+            // The pool grows when all workers are busy:
+            QChildProcess *worker = qIdleWorker();
+
+            if (worker == NULL and workers.length() < maximumWorkers) {
+                worker = qStartWorker();
+            }
+
+            if (worker == NULL) {
+                return;
+            }
+
+            QPointer<QWebEngineUrlRequestJob> job = pendingJobs.takeFirst();
+
+            if (job.isNull()) {
+                continue;
+            }
+
+            worker->setProperty("busy", true);
+
+            QLocalSocket *connection = new QLocalSocket(this);
+            requestJobs.insert(connection, job);
+            requestWorkers.insert(connection, worker);
+            requestData.insert(connection, qFastCgiRequest(job));
+            responseData.insert(connection, QByteArray());
+
+            QObject::connect(connection, SIGNAL(connected()),
+                             this, SLOT(qConnectedSlot()));
+
+            QObject::connect(connection, SIGNAL(readyRead()),
+                             this, SLOT(qResponseSlot()));
+
+            QObject::connect(connection, SIGNAL(disconnected()),
+                             this, SLOT(qRequestFinishedSlot()));
+
+            QObject::connect(connection,
+                             SIGNAL(error(QLocalSocket::LocalSocketError)),
+                             this,
+                             SLOT(qRequestFinishedSlot()));
+
+            connection->connectToServer(
+                        worker->property("socketPath").toString());
+        }
+    }
+
+    void qConnectedSlot()
+    {
+        QLocalSocket *connection = qobject_cast<QLocalSocket*>(sender());
+        connection->write(requestData.take(connection));
+    }
+
+    void qResponseSlot()
+    {
+        QLocalSocket *connection = qobject_cast<QLocalSocket*>(sender());
+
+        if (responseData.contains(connection)) {
+            if (!connection->property("firstByteTime").isValid()) {
+                connection->setProperty("firstByteTime",
+                                        poolClock.nsecsElapsed());
+            }
+
+            responseData[connection].append(connection->readAll());
+        }
+    }
+
+    void qRequestFinishedSlot()
+    {
+        QLocalSocket *connection = qobject_cast<QLocalSocket*>(sender());
+
+        // Errors are followed by disconnection and
+        // every request is finished only once:
+        if (!requestJobs.contains(connection)) {
+            return;
+        }
+
+        if (connection->bytesAvailable() > 0) {
+            responseData[connection].append(connection->readAll());
+        }
+
+        QPointer<QWebEngineUrlRequestJob> job = requestJobs.take(connection);
+        QPointer<QChildProcess> worker = requestWorkers.take(connection);
+        QByteArray response = responseData.take(connection);
+        requestData.remove(connection);
+
+        // The worker may have finished and may be deleted already:
+        if (!worker.isNull()) {
+            worker->setProperty("busy", false);
+            worker->setProperty("idleSince", poolClock.elapsed());
+        }
+
+        connection->deleteLater();
+
+        if (!job.isNull()) {
+            qint64 startTime = job->property("startTime").toLongLong();
+            qint64 firstByteTime = poolClock.nsecsElapsed();
+
+            if (connection->property("firstByteTime").isValid()) {
+                firstByteTime =
+                        connection->property("firstByteTime").toLongLong();
+            }
+
+            int size = qReply(job, response);
+
+            QRequestStatistics::instance()->qRecord(
+                        QString::fromLatin1(job->requestMethod()),
+                        job->requestUrl(),
+                        (firstByteTime - startTime) / 1000,
+                        (poolClock.nsecsElapsed() - startTime) / 1000,
+                        size);
+        }
+
+        qDispatchSlot();
+    }
+
+    // ==============================
+    // Worker pool:
+    // ==============================
+    void qWorkerOutputSlot()
+    {
+        QChildProcess *worker = qobject_cast<QChildProcess*>(sender());
+
+        if (log != NULL) {
+            log->write(worker->readAllStandardOutput());
+            log->flush();
+        }
+    }
+
+    void qWorkerFinishedSlot()
+    {
+        QChildProcess *worker = qobject_cast<QChildProcess*>(sender());
+
+        workers.removeAll(worker);
+        QFile::remove(worker->property("socketPath").toString());
+        worker->deleteLater();
+
+        // Requests still sent to the finished worker fail when
+        // their connections are closed and waiting requests need
+        // a new worker:
+        if (stopping == false) {
+            qDispatchSlot();
+        }
+    }
+
+    void qWorkerErrorSlot(QProcess::ProcessError error)
+    {
+        // A worker that failed to start never finishes and
+        // must not be counted in the pool or receive requests:
+        if (error != QProcess::FailedToStart) {
+            return;
+        }
+
+        QChildProcess *worker = qobject_cast<QChildProcess*>(sender());
+
+        if (!workers.contains(worker)) {
+            return;
+        }
+
+        workers.removeAll(worker);
+        QFile::remove(worker->property("socketPath").toString());
+        worker->deleteLater();
+
+        if (log != NULL) {
+            log->write("FastCGI worker failed to start: " +
+                       worker->errorString().toUtf8() + "\n");
+            log->flush();
+        }
+
+        // Waiting requests are dispatched to the running workers
+        // when they are idle again and fail when no worker is running,
+        // because a new worker would fail to start in the same way:
+        if (workers.isEmpty()) {
+            while (!pendingJobs.isEmpty()) {
+                QPointer<QWebEngineUrlRequestJob> job =
+                        pendingJobs.takeFirst();
+
+                if (!job.isNull()) {
+                    job->fail(QWebEngineUrlRequestJob::RequestFailed);
+                }
+            }
+        }
+    }
+
+    void qPoolMaintenanceSlot()
+    {
+        // Idle workers above the minimum are stopped after
+        // the idle timeout and the minimum number of workers is kept:
+        int activeWorkers = 0;
+
+        foreach (QChildProcess *worker, workers) {
+            if (worker->property("retiring").toBool() == true) {
+                continue;
+            }
+
+            activeWorkers++;
+
+            if (activeWorkers > minimumWorkers and
+                    worker->property("busy").toBool() == false and
+                    poolClock.elapsed() -
+                    worker->property("idleSince").toLongLong() >
+                    idleTimeout) {
+                worker->setProperty("retiring", true);
+                worker->terminateProcessGroup();
+                activeWorkers--;
+            }
+        }
+
+        while (stopping == false and activeWorkers < minimumWorkers) {
+            if (qStartWorker() == NULL) {
+                break;
+            }
+
+            activeWorkers++;
+        }
+    }
+
+    void qStopWorkersSlot()
+    {
+        stopping = true;
+        poolMaintenanceTimer->stop();
+
+        // Workers are terminated and killed by the server starter,
+        // which waits for them without blocking the event loop:
+        foreach (QChildProcess *worker, workers) {
+            worker->setProperty("retiring", true);
+        }
+
+        socketDirectory.remove();
+    }
+
+public:
+    QFastCgiHandler(QStringList workerArguments,
+                    int minimumWorkerCount,
+                    int maximumWorkerCount,
+                    int workerIdleTimeout,
+                    QFile *logFile);
+
+    void requestStarted(QWebEngineUrlRequestJob *job) override;
+
+    QList<QChildProcess*> workers;
+    QResponseCache *responseCache;
+    int minimumWorkers;
+    int maximumWorkers;
+
+private:
+    QChildProcess *qIdleWorker();
+    QChildProcess *qStartWorker();
+    QByteArray qFastCgiRequest(QWebEngineUrlRequestJob *job);
+    int qReply(QWebEngineUrlRequestJob *job, QByteArray response);
+    void qReplyData(QWebEngineUrlRequestJob *job,
+                    QByteArray contentType,
+                    QByteArray data);
+
+    QStringList arguments;
+    QFile *log;
+    QTemporaryDir socketDirectory;
+    int workerNumber;
+    int idleTimeout;
+    bool stopping;
+
+    QElapsedTimer poolClock;
+    QTimer *poolMaintenanceTimer;
+
+    QList<QPointer<QWebEngineUrlRequestJob> > pendingJobs;
+    QHash<QLocalSocket*, QPointer<QWebEngineUrlRequestJob> > requestJobs;
+    QHash<QLocalSocket*, QPointer<QChildProcess> > requestWorkers;
+    QHash<QLocalSocket*, QByteArray> requestData;
+    QHash<QLocalSocket*, QByteArray> responseData;
+};
+
+#endif // FASTCGI_HANDLER_H
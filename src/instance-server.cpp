@@ -0,0 +1,157 @@
+/*
+ Perl Executing Browser
+
+ This program is free software;
+ you can redistribute it and/or modify it under the terms of the
+ GNU Lesser General Public License,
+ as published by the Free Software Foundation;
+ either version 3 of the License, or (at your option) any later version.
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY;
+ without even the implied warranty of MERCHANTABILITY or
+ FITNESS FOR A PARTICULAR PURPOSE.
+ Dimitar D. Mitov, 2013 - 2019
+ Valcho Nedelchev, 2014 - 2016
+ https://github.com/ddmitov/perl-executing-browser
+*/
+#include <QtWidgets/QApplication>
+#include <QCryptographicHash>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+
+#include "instance-server.h"
+
+#if QT_VERSION < QT_VERSION_CHECK(5, 6, 0)
+#include "webkit-main-window.h"
+#endif
+
+#if QT_VERSION > QT_VERSION_CHECK(5, 5, 0)
+#if ANNULEN_QTWEBKIT == 0
+#include "webengine-main-window.h"
+#endif
+
+#if ANNULEN_QTWEBKIT == 1
+#include "webkit-main-window.h"
+#endif
+#endif
+
+// ==============================
+// INSTANCE SERVER CONSTRUCTOR:
+// ==============================
+QInstanceServer::QInstanceServer(QString serverName)
+    : QObject(qApp)
+{
+    localServer = new QLocalServer(this);
+    localServer->setSocketOptions(QLocalServer::UserAccessOption);
+
+    // A socket file left by a crashed instance is removed, but
+    // the socket of an instance accepting connections is never removed:
+    if (!localServer->listen(serverName)) {
+        QLocalSocket probe;
+        probe.connectToServer(serverName);
+
+        if (probe.waitForConnected(100)) {
+            probe.abort();
+        } else {
+            QLocalServer::removeServer(serverName);
+            localServer->listen(serverName);
+        }
+    }
+
+    QObject::connect(localServer, SIGNAL(newConnection()),
+                     this, SLOT(qNewConnectionSlot()));
+}
+
+QString QInstanceServer::qServerName(QString applicationDirectory)
+{
+    QByteArray userName = qgetenv("USER");
+    if (userName.length() == 0) {
+        userName = qgetenv("USERNAME");
+    }
+
+    QByteArray instanceKey = QCryptographicHash::hash(
+                userName + "/" + applicationDirectory.toUtf8(),
+                QCryptographicHash::Sha1).toHex();
+
+    return QString("peb-") + QString::fromLatin1(instanceKey.left(16));
+}
+
+// ==============================
+// Later launches:
+// ==============================
+bool QInstanceServer::qForwardCommand(QString serverName,
+                                      QStringList arguments)
+{
+    QLocalSocket socket;
+    socket.connectToServer(serverName);
+
+    if (!socket.waitForConnected(500)) {
+        return false;
+    }
+
+    QJsonDocument command(QJsonArray::fromStringList(arguments));
+
+    socket.write(command.toJson(QJsonDocument::Compact) + "\n");
+    socket.waitForBytesWritten(1000);
+    socket.disconnectFromServer();
+
+    return true;
+}
+
+// ==============================
+// Running instance:
+// ==============================
+void QInstanceServer::qReadCommandSlot()
+{
+    QLocalSocket *client = qobject_cast<QLocalSocket*>(sender());
+
+    while (client != NULL and client->canReadLine()) {
+        QJsonDocument command = QJsonDocument::fromJson(client->readLine());
+
+        QStringList arguments;
+        foreach (QJsonValue argument, command.array()) {
+            arguments.append(argument.toString());
+        }
+
+        QMainBrowserWindow::qShowWindow(qCommandUrl(arguments));
+    }
+}
+
+QUrl QInstanceServer::qCommandUrl(QStringList arguments)
+{
+    // The first argument after the browser executable,
+    // which is not an option like --trace-file=path, is
+    // a page relative to the application directory.
+    // Pages of a local server are requested from the same server:
+    QString page;
+
+    for (int index = 1; index < arguments.length(); index++) {
+        if (!arguments[index].startsWith("-")) {
+            page = arguments[index];
+            break;
+        }
+    }
+
+    if (page.length() == 0) {
+        return QUrl();
+    }
+
+    QString applicationDirName = qApp->property("application").toString();
+    QString localServerBaseUrl =
+            qApp->property("local_server_base_url").toString();
+
+    if (localServerBaseUrl.length() > 0) {
+        return QUrl(localServerBaseUrl).resolved(QUrl(page));
+    }
+
+    QFileInfo pageFile(applicationDirName + "/" + page);
+
+    if (pageFile.exists() and
+            pageFile.canonicalFilePath().startsWith(
+                QFileInfo(applicationDirName).canonicalFilePath())) {
+        return QUrl::fromLocalFile(pageFile.canonicalFilePath());
+    }
+
+    return QUrl();
+}
@@ -0,0 +1,65 @@
+/*
+ Perl Executing Browser
+
+ This program is free software;
+ you can redistribute it and/or modify it under the terms of the
+ GNU Lesser General Public License,
+ as published by the Free Software Foundation;
+ either version 3 of the License, or (at your option) any later version.
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY;
+ without even the implied warranty of MERCHANTABILITY or
+ FITNESS FOR A PARTICULAR PURPOSE.
+ Dimitar D. Mitov, 2013 - 2019
+ Valcho Nedelchev, 2014 - 2016
+ https://github.com/ddmitov/perl-executing-browser
+*/
+#ifndef INSTANCE_SERVER_H
+#define INSTANCE_SERVER_H
+
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QObject>
+#include <QStringList>
+#include <QUrl>
+
+// ==============================
+// INSTANCE SERVER CLASS DEFINITION:
+// Command line arguments of later launches
+// forwarded to the running browser instance
+// ==============================
+class QInstanceServer : public QObject
+{
+    Q_OBJECT
+
+public slots:
+    void qNewConnectionSlot()
+    {
+        while (localServer->hasPendingConnections()) {
+            QLocalSocket *client = localServer->nextPendingConnection();
+
+            QObject::connect(client, SIGNAL(readyRead()),
+                             this, SLOT(qReadCommandSlot()));
+            QObject::connect(client, SIGNAL(disconnected()),
+                             client, SLOT(deleteLater()));
+        }
+    }
+
+    void qReadCommandSlot();
+
+public:
+    explicit QInstanceServer(QString serverName);
+
+    // Every application directory of every user has its own instance:
+    static QString qServerName(QString applicationDirectory);
+
+    // True if the arguments are received by a running instance:
+    static bool qForwardCommand(QString serverName, QStringList arguments);
+
+private:
+    QUrl qCommandUrl(QStringList arguments);
+
+    QLocalServer *localServer;
+};
+
+#endif // INSTANCE_SERVER_H
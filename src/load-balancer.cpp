@@ -0,0 +1,50 @@
+/*
+ Perl Executing Browser
+
+ This program is free software;
+ you can redistribute it and/or modify it under the terms of the
+ GNU Lesser General Public License,
+ as published by the Free Software Foundation;
+ either version 3 of the License, or (at your option) any later version.
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY;
+ without even the implied warranty of MERCHANTABILITY or
+ FITNESS FOR A PARTICULAR PURPOSE.
+ Dimitar D. Mitov, 2013 - 2019
+ Valcho Nedelchev, 2014 - 2016
+ https://github.com/ddmitov/perl-executing-browser
+*/
+
+#include "load-balancer.h"
+
+// ==============================
+// LOAD BALANCER CONSTRUCTOR:
+// ==============================
+QLoadBalancer::QLoadBalancer(QTcpServer *listeningSocket,
+                             QList<QChildProcess*> localServerInstances)
+    : QObject(0)
+{
+    frontSocket = listeningSocket;
+    frontSocket->setParent(this);
+
+    // Instance ports are copied, because
+    // instance objects are used only in the GUI thread:
+    foreach (QChildProcess *instance, localServerInstances) {
+        QBackend backend;
+        backend.port = instance->property("port").toInt();
+        backends.append(backend);
+    }
+
+    QObject::connect(frontSocket, SIGNAL(newConnection()),
+                     this, SLOT(qNewConnectionSlot()));
+
+    // The load balancer and its sockets live in their own thread:
+    QThread *loadBalancerThread = new QThread();
+    QObject::connect(loadBalancerThread, SIGNAL(finished()),
+                     loadBalancerThread, SLOT(deleteLater()));
+
+    moveToThread(loadBalancerThread);
+    loadBalancerThread->start();
+
+    QMetaObject::invokeMethod(this, "qStartSlot", Qt::QueuedConnection);
+}
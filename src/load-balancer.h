@@ -0,0 +1,197 @@
+/*
+ Perl Executing Browser
+
+ This program is free software;
+ you can redistribute it and/or modify it under the terms of the
+ GNU Lesser General Public License,
+ as published by the Free Software Foundation;
+ either version 3 of the License, or (at your option) any later version.
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY;
+ without even the implied warranty of MERCHANTABILITY or
+ FITNESS FOR A PARTICULAR PURPOSE.
+ Dimitar D. Mitov, 2013 - 2019
+ Valcho Nedelchev, 2014 - 2016
+ https://github.com/ddmitov/perl-executing-browser
+*/
+
+#ifndef LOAD_BALANCER_H
+#define LOAD_BALANCER_H
+
+#include <QHostAddress>
+#include <QObject>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QThread>
+
+#include "child-process.h"
+
+// ==============================
+// LOCAL SERVER BACKEND:
+// State of one local server instance as seen by the load balancer.
+// It is kept in the thread of the load balancer,
+// so that no instance object is touched outside of the GUI thread.
+// ==============================
+struct QBackend
+{
+    QBackend() : port(0), ready(false), connections(0) {}
+
+    int port;
+    bool ready;
+    int connections;
+};
+
+// ==============================
+// LOAD BALANCER CLASS DEFINITION:
+// Connection-level proxy spreading browser connections
+// across several local server instances.
+// It runs in its own thread, so that
+// proxied data never waits for the GUI event loop.
+// ==============================
+class QLoadBalancer : public QObject
+{
+    Q_OBJECT
+
+public slots:
+    void qStartSlot()
+    {
+        // The listening socket is paused by the port scanner and
+        // connections are accepted by the load balancer from now on:
+        frontSocket->resumeAccepting();
+    }
+
+    void qStopSlot()
+    {
+        frontSocket->close();
+        thread()->quit();
+    }
+
+    void qBackendReadySlot(int index, bool ready)
+    {
+        if (index >= 0 and index < backends.length()) {
+            backends[index].ready = ready;
+        }
+    }
+
+    void qNewConnectionSlot()
+    {
+        while (frontSocket->hasPendingConnections()) {
+            QTcpSocket *client = frontSocket->nextPendingConnection();
+
+            // The ready instance with the least open connections is used.
+            // A connection stays with its instance until it is closed,
+            // so WebSocket and long-polling connections are sticky.
+            int index = -1;
+            for (int candidate = 0;
+                 candidate < backends.length();
+                 candidate++) {
+                if (backends[candidate].ready == true) {
+                    if (index < 0 or
+                            backends[candidate].connections <
+                            backends[index].connections) {
+                        index = candidate;
+                    }
+                }
+            }
+
+            if (index < 0) {
+                client->abort();
+                client->deleteLater();
+                continue;
+            }
+
+            backends[index].connections++;
+
+            QTcpSocket *backend = new QTcpSocket(this);
+            backend->setProperty("backend", index);
+
+            client->setProperty(
+                        "peer", QVariant::fromValue<QObject*>(backend));
+            backend->setProperty(
+                        "peer", QVariant::fromValue<QObject*>(client));
+
+            foreach (QTcpSocket *socket, QList<QTcpSocket*>()
+                     << client << backend) {
+                QObject::connect(socket, SIGNAL(readyRead()),
+                                 this, SLOT(qForwardSlot()));
+                QObject::connect(socket, SIGNAL(disconnected()),
+                                 this, SLOT(qDisconnectedSlot()));
+                QObject::connect(socket,
+                                 SIGNAL(error(QAbstractSocket::SocketError)),
+                                 this,
+                                 SLOT(qDisconnectedSlot()));
+            }
+
+            // Data sent by the browser before the backend connection is
+            // established is buffered by the backend socket:
+            backend->connectToHost(QHostAddress::LocalHost,
+                                   backends[index].port);
+
+            qForwardSlot(client);
+        }
+    }
+
+    void qForwardSlot(QTcpSocket *source = NULL)
+    {
+        if (source == NULL) {
+            source = qobject_cast<QTcpSocket*>(sender());
+        }
+
+        QTcpSocket *target = qobject_cast<QTcpSocket*>(
+                    source->property("peer").value<QObject*>());
+
+        if (target != NULL and source->bytesAvailable() > 0) {
+            target->write(source->readAll());
+        }
+    }
+
+    void qDisconnectedSlot()
+    {
+        QTcpSocket *socket = qobject_cast<QTcpSocket*>(sender());
+
+        // A socket closed by its peer is deleted after
+        // all its buffered data is written:
+        if (socket->property("closed").toBool() == true) {
+            socket->deleteLater();
+            return;
+        }
+
+        QTcpSocket *peer = qobject_cast<QTcpSocket*>(
+                    socket->property("peer").value<QObject*>());
+
+        QTcpSocket *backend = socket;
+        if (socket->property("backend").isNull()) {
+            backend = peer;
+        }
+
+        int index = backend->property("backend").toInt();
+
+        if (index >= 0 and index < backends.length()) {
+            backends[index].connections--;
+        }
+
+        // Data still buffered for the peer is written before it is closed:
+        socket->setProperty("closed", true);
+        peer->setProperty("closed", true);
+
+        if (socket->bytesAvailable() > 0) {
+            peer->write(socket->readAll());
+        }
+
+        peer->disconnectFromHost();
+        if (peer->state() == QAbstractSocket::UnconnectedState) {
+            peer->deleteLater();
+        }
+
+        socket->deleteLater();
+    }
+
+public:
+    QLoadBalancer(QTcpServer *listeningSocket,
+                  QList<QChildProcess*> localServerInstances);
+
+    QTcpServer *frontSocket;
+    QList<QBackend> backends;
+};
+
+#endif // LOAD_BALANCER_H
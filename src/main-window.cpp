@@ -31,6 +31,9 @@
 #endif
 #endif
 
+#include "background-monitor.h"
+#include "shutdown-coordinator.h"
+
 // ==============================
 // MAIN WINDOW CLASS CONSTRUCTOR:
 // ==============================
@@ -38,4 +41,93 @@ QMainBrowserWindow::QMainBrowserWindow(QWidget *parent)
     : QMainWindow(parent)
 {
     webViewWidget = new QViewWidget();
+    setCentralWidget(webViewWidget);
+
+    // Every window is deleted with its view and page when it is closed:
+    setAttribute(Qt::WA_DeleteOnClose);
+
+    // Window property used when closing the window is requested:
+    setProperty("windowCloseRequested", false);
+
+    // Signal and slot for setting the window title:
+    QObject::connect(webViewWidget, SIGNAL(titleChanged(QString)),
+                     this, SLOT(setMainWindowTitleSlot(QString)));
+
+#if QT_VERSION >= QT_VERSION_CHECK(5, 6, 0)
+#if ANNULEN_QTWEBKIT == 0
+    // Signal and slot for fullscreen video:
+    QObject::connect(webViewWidget->page(),
+                     SIGNAL(fullScreenRequested(QWebEngineFullScreenRequest)),
+                     this,
+                     SLOT(qGoFullscreen(QWebEngineFullScreenRequest)));
+#endif
+#endif
+
+    // Signal and slot for closing the window:
+    QObject::connect(this, SIGNAL(startMainWindowClosingSignal()),
+                     webViewWidget->page(), SLOT(qStartWindowClosingSlot()));
+
+    // Signals and slots for the timed and bounded shutdown:
+    QObject::connect(webViewWidget->page(), SIGNAL(closingScriptsSignal()),
+                     QShutdownCoordinator::instance(),
+                     SLOT(qClosingScriptsSlot()));
+
+    QObject::connect(webViewWidget->page(), SIGNAL(closeWindowSignal()),
+                     QShutdownCoordinator::instance(),
+                     SLOT(qScriptsClosedSlot()));
+
+    // Signal and slot for scripts running while the window is hidden:
+    QBackgroundMonitor *backgroundMonitor = new QBackgroundMonitor(this);
+
+    QObject::connect(backgroundMonitor,
+                     SIGNAL(backgroundChangedSignal(bool)),
+                     webViewWidget->page(),
+                     SLOT(qBackgroundChangedSlot(bool)));
+}
+
+// ==============================
+// Windows requested outside of pages:
+// ==============================
+void QMainBrowserWindow::qShowWindow(QUrl url)
+{
+    QMainBrowserWindow *lastWindow = NULL;
+
+    if (!url.isValid()) {
+        foreach (QWidget *widget, QApplication::topLevelWidgets()) {
+            QMainBrowserWindow *window =
+                    qobject_cast<QMainBrowserWindow*>(widget);
+
+            if (window != NULL and window->isVisible()) {
+                lastWindow = window;
+
+                if (window == QApplication::activeWindow()) {
+                    break;
+                }
+            }
+        }
+    }
+
+    if (lastWindow != NULL) {
+        if (lastWindow->isMinimized()) {
+            lastWindow->showMaximized();
+        }
+
+        lastWindow->raise();
+        lastWindow->activateWindow();
+        return;
+    }
+
+    if (!url.isValid()) {
+        url = qApp->property("startUrl").toUrl();
+    }
+
+    if (!url.isValid()) {
+        url = QUrl(qApp->property("local_server_base_url").toString());
+    }
+
+    QMainBrowserWindow *window = new QMainBrowserWindow();
+    window->webViewWidget->setUrl(url);
+    window->showMaximized();
+    window->raise();
+    window->activateWindow();
 }
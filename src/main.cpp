@@ -16,10 +16,24 @@
 */
 
 #include <QtWidgets/QApplication>
+#include <QElapsedTimer>
+#include <QJsonDocument>
+#include <QJsonObject>
 #include <QTextCodec>
 #include <QtGlobal>
 
+#include <climits>
+
+#include "file-reader.h"
+#include "instance-server.h"
+#include "metrics.h"
+#include "resident-mode.h"
+#include "script-scheduler.h"
 #include "server-starter.h"
+#include "shutdown-coordinator.h"
+#include "stall-watchdog.h"
+#include "startup-monitor.h"
+#include "trace-recorder.h"
 
 #if QT_VERSION < QT_VERSION_CHECK(5, 6, 0)
 #include "webkit-main-window.h"
@@ -28,6 +42,10 @@
 #if QT_VERSION > QT_VERSION_CHECK(5, 5, 0)
 #if ANNULEN_QTWEBKIT == 0
 #include "webengine-main-window.h"
+#include <QWebEngineProfile>
+#if QT_VERSION >= QT_VERSION_CHECK(5, 12, 0)
+#include <QWebEngineUrlScheme>
+#endif
 #endif
 
 #if ANNULEN_QTWEBKIT == 1
@@ -40,8 +58,63 @@
 // ==============================
 int main(int argc, char **argv)
 {
+    // ==============================
+    // Startup latency:
+    // ==============================
+    QElapsedTimer startupTimer;
+    startupTimer.start();
+
+    // ==============================
+    // Trace file and stall watchdog:
+    // ==============================
+    // Spans of the startup, the page loads, the scripts and the shutdown
+    // are recorded if the --trace-file=path option is given.
+    // Stalls of the GUI event loop are logged if
+    // the --stall-threshold=milliseconds option is given:
+    int stallThreshold = 0;
+
+    for (int index = 1; index < argc; index++) {
+        QString argument = QString::fromLocal8Bit(argv[index]);
+
+        if (argument.startsWith("--trace-file=")) {
+            QTraceRecorder::instance()->qOpen(
+                        argument.mid(QString("--trace-file=").length()),
+                        startupTimer);
+        }
+
+        if (argument.startsWith("--stall-threshold=")) {
+            stallThreshold =
+                    argument.mid(QString("--stall-threshold=").length())
+                    .toInt();
+        }
+    }
+
+    // ==============================
+    // Local server URL scheme:
+    // ==============================
+    // The URL scheme of the FastCGI mode must be registered
+    // before the application is created:
+#if QT_VERSION >= QT_VERSION_CHECK(5, 12, 0)
+#if ANNULEN_QTWEBKIT == 0
+    QWebEngineUrlScheme localServerScheme("local-server");
+    localServerScheme.setSyntax(QWebEngineUrlScheme::Syntax::Host);
+    localServerScheme.setFlags(QWebEngineUrlScheme::SecureScheme |
+                               QWebEngineUrlScheme::LocalAccessAllowed |
+                               QWebEngineUrlScheme::CorsEnabled);
+    QWebEngineUrlScheme::registerScheme(localServerScheme);
+#endif
+#endif
+
+    qint64 applicationSpan = QTraceRecorder::instance()->qNow();
+
     QApplication application(argc, argv);
 
+    QTraceRecorder::instance()->qComplete(
+                "startup", "QApplication", applicationSpan);
+
+    QStartupMonitor::instance()->qStart(startupTimer);
+    QStallWatchdog::instance()->qStart(stallThreshold);
+
     // ==============================
     // Application version:
     // ==============================
@@ -52,6 +125,8 @@ int main(int argc, char **argv)
     // ==============================
     QTextCodec::setCodecForLocale(QTextCodec::codecForName("UTF8"));
 
+    qint64 directoriesSpan = QTraceRecorder::instance()->qNow();
+
     // ==============================
     // Directory of the browser executable:
     // ==============================
@@ -153,65 +228,191 @@ int main(int argc, char **argv)
 
     qputenv("PERL5LIB", perlLibDirArray);
 
+    QTraceRecorder::instance()->qComplete(
+                "startup", "resource directories", directoriesSpan);
+
+    qint64 settingsSpan = QTraceRecorder::instance()->qNow();
+
     // ==============================
-    // Application icon:
+    // Default resource limits of Perl scripts:
     // ==============================
-    QString iconPathName = resourcesDirectory + "/app.png";
+    QString scriptLimitsFilePath = applicationDirName + "/script-limits.json";
+
+    if (QFile(scriptLimitsFilePath).exists()) {
+        QFileReader *scriptLimitsReader =
+                new QFileReader(scriptLimitsFilePath);
+        QJsonDocument scriptLimitsJsonDocument =
+                QJsonDocument::fromJson(
+                    scriptLimitsReader->fileContents.toUtf8());
+
+        application.setProperty(
+                    "scriptLimits",
+                    scriptLimitsJsonDocument.object().toVariantMap());
+    }
 
-    QPixmap icon(32, 32);
-    QFile iconFile(iconPathName);
-    if (iconFile.exists()) {
-        icon.load(iconPathName);
-        QApplication::setWindowIcon(icon);
-    } else {
-        // Set the embedded default icon
-        // in case no external icon file is found:
-        icon.load(":/icon/camel.png");
-        QApplication::setWindowIcon(icon);
+    // ==============================
+    // Runtime profile:
+    // ==============================
+    // The "low-memory" profile keeps the peak memory of the browser low
+    // on constrained devices. Every value of the profile can be
+    // overridden in the runtime file. Cache sizes are set in megabytes.
+    QString runtimeFilePath = applicationDirName + "/runtime.json";
+    QJsonObject runtimeJson;
+
+    if (QFile(runtimeFilePath).exists()) {
+        QFileReader *runtimeReader = new QFileReader(runtimeFilePath);
+        runtimeJson = QJsonDocument::fromJson(
+                    runtimeReader->fileContents.toUtf8()).object();
+    }
+
+    bool lowMemory = (runtimeJson["profile"].toString() == "low-memory");
+
+    // Cache sizes are limited to 1 TB, so that
+    // they can be converted to bytes without an overflow:
+    application.setProperty(
+                "httpCacheSize",
+                qBound(0,
+                       runtimeJson["http-cache"].toInt(lowMemory ? 32 : 256),
+                       1024 * 1024));
+    application.setProperty(
+                "memoryCacheSize",
+                qBound(0,
+                       runtimeJson["memory-cache"].toInt(lowMemory ? 8 : 0),
+                       1024 * 1024));
+    application.setProperty(
+                "pluginsEnabled",
+                runtimeJson["plugins"].toBool(!lowMemory));
+
+#if QT_VERSION >= QT_VERSION_CHECK(5, 6, 0)
+#if ANNULEN_QTWEBKIT == 0
+    // Chromium settings are read when the first page is created:
+    QStringList chromiumFlags;
+
+    int rendererProcesses =
+            runtimeJson["renderer-processes"].toInt(lowMemory ? 1 : 0);
+    if (rendererProcesses > 0) {
+        chromiumFlags.append("--renderer-process-limit=" +
+                             QString::number(rendererProcesses));
+    }
+
+    int javaScriptHeap =
+            runtimeJson["javascript-heap"].toInt(lowMemory ? 128 : 0);
+    if (javaScriptHeap > 0) {
+        chromiumFlags.append("--js-flags=--max-old-space-size=" +
+                             QString::number(javaScriptHeap));
+    }
+
+    if (runtimeJson["low-end-device-mode"].toBool(lowMemory) == true) {
+        chromiumFlags.append("--enable-low-end-device-mode");
     }
 
+    if (chromiumFlags.length() > 0) {
+        QByteArray existingFlags = qgetenv("QTWEBENGINE_CHROMIUM_FLAGS");
+        if (existingFlags.length() > 0) {
+            chromiumFlags.prepend(QString::fromLatin1(existingFlags));
+        }
+
+        qputenv("QTWEBENGINE_CHROMIUM_FLAGS",
+                chromiumFlags.join(" ").toLatin1());
+    }
+#endif
+#endif
+
+    // The global limit of running scripts is
+    // one script for every processor core by default:
+    if (runtimeJson["maximum-scripts"].toInt() > 0) {
+        QScriptScheduler::instance()->maximumScripts =
+                runtimeJson["maximum-scripts"].toInt();
+    }
+
+    QTraceRecorder::instance()->qComplete(
+                "startup", "runtime settings", settingsSpan);
+
     // ==============================
-    // MAIN WINDOW INITIALIZATION:
+    // Script lifecycle markers:
+    // ==============================
+    // Markers of all scripts are added to the performance timeline
+    // when DevTools are available on the remote debugging port:
+    application.setProperty(
+                "performanceMarks",
+                application.arguments().filter(
+                    "--remote-debugging-port").length() > 0 or
+                qgetenv("QTWEBENGINE_REMOTE_DEBUGGING").length() > 0);
+
     // ==============================
-    QMainBrowserWindow mainWindow;
-    mainWindow.setWindowIcon(icon);
-    mainWindow.setCentralWidget(mainWindow.webViewWidget);
+    // Single instance:
+    // ==============================
+    // A later launch forwards its arguments to the running instance and
+    // exits before the browser engine is started.
+    // A resident instance is a single instance by default:
+    bool resident = runtimeJson["resident"].toBool(false);
+
+    if (runtimeJson["single-instance"].toBool(resident) == true) {
+        QString instanceServerName =
+                QInstanceServer::qServerName(applicationDirName);
+
+        if (QInstanceServer::qForwardCommand(instanceServerName,
+                                             application.arguments())) {
+            return 0;
+        }
 
-    // Application property used when closing the browser window is requested:
-    qApp->setProperty("windowCloseRequested", false);
+        new QInstanceServer(instanceServerName);
+    }
 
     // ==============================
-    // Signals and slots:
+    // Metrics:
     // ==============================
-    // Signal and slot for setting the main window title:
-    QObject::connect(mainWindow.webViewWidget,
-                     SIGNAL(titleChanged(QString)),
-                     &mainWindow,
-                     SLOT(setMainWindowTitleSlot(QString)));
+    // Metrics are exported only by the running instance and
+    // the port is bound only on the loopback interface:
+    QMetrics::instance()->qStart(runtimeJson["metrics-file"].toBool(false),
+                                 runtimeJson["metrics-port"].toInt(0),
+                                 runtimeJson["metrics-interval"].toInt(15));
 
 #if QT_VERSION >= QT_VERSION_CHECK(5, 6, 0)
-    if (ANNULEN_QTWEBKIT == 0) {
-        // Signal and slot for fullscreen video:
-        QObject::connect(mainWindow.webViewWidget->page(),
-                         SIGNAL(fullScreenRequested(QWebEngineFullScreenRequest)),
-                         &mainWindow,
-                         SLOT(qGoFullscreen(QWebEngineFullScreenRequest)));
-    }
+#if ANNULEN_QTWEBKIT == 0
+    // ==============================
+    // Browser engine profile:
+    // ==============================
+    // Persistent HTTP cache in the data directory shared by all pages.
+    // Responses of the local server and remote assets are
+    // revalidated by the browser engine using their validators:
+    QWebEngineProfile::defaultProfile()->
+            setCachePath(QString::fromLatin1(qgetenv("PEB_DATA_DIR")) +
+                         "/cache/engine");
+    QWebEngineProfile::defaultProfile()->
+            setHttpCacheType(QWebEngineProfile::DiskHttpCache);
+
+    // The maximum size of the cache is an int number of bytes:
+    qint64 httpCacheBytes =
+            application.property("httpCacheSize").toLongLong() * 1024 * 1024;
+    QWebEngineProfile::defaultProfile()->
+            setHttpCacheMaximumSize(
+                int(qMin(httpCacheBytes, qint64(INT_MAX))));
+#endif
 #endif
 
-    // Signal and slot for closing the main window:
-    QObject::connect(&mainWindow,
-                     SIGNAL(startMainWindowClosingSignal()),
-                     mainWindow.webViewWidget->page(),
-                     SLOT(qStartWindowClosingSlot()));
+    // ==============================
+    // Application icon:
+    // ==============================
+    QString iconPathName = resourcesDirectory + "/app.png";
 
-    // Signal and slot for actions taken before application exit:
-    QObject::connect(qApp, SIGNAL(aboutToQuit()),
-                     &mainWindow, SLOT(qExitApplicationSlot()));
+    QPixmap icon(32, 32);
+    QFile iconFile(iconPathName);
+    if (iconFile.exists()) {
+        icon.load(iconPathName);
+        QApplication::setWindowIcon(icon);
+    } else {
+        // Set the embedded default icon
+        // in case no external icon file is found:
+        icon.load(":/icon/camel.png");
+        QApplication::setWindowIcon(icon);
+    }
 
     // ==============================
     // Start file:
     // ==============================
+    // The local server is started before the main window,
+    // so that it is loaded while the browser engine is initialized.
     bool startFileFound = false;
 
     QString startPageFilePath = applicationDirName + "/index.html";
@@ -221,35 +422,105 @@ int main(int argc, char **argv)
     QFile startPageFile(startPageFilePath);
     QFile localServerSettingsFile(localServerSettingsFilePath);
 
+    QServerStarter *serverStarter = NULL;
+
     // Local file:
     if (startPageFile.exists()) {
         startFileFound = true;
 
-        mainWindow.webViewWidget->setUrl(
-                    QUrl::fromLocalFile(startPageFilePath));
+        qApp->setProperty("startUrl", QUrl::fromLocalFile(startPageFilePath));
     }
 
     // Local server:
     if ((!startPageFile.exists()) and localServerSettingsFile.exists()) {
         startFileFound = true;
 
-        QServerStarter *serverStarter =
-                new QServerStarter(localServerSettingsFilePath);
+        qint64 serverStarterSpan = QTraceRecorder::instance()->qNow();
+
+        serverStarter = new QServerStarter(localServerSettingsFilePath);
+
+        QTraceRecorder::instance()->qComplete(
+                    "startup", "QServerStarter", serverStarterSpan);
+
+        QShutdownCoordinator::instance()->serverStarter = serverStarter;
+    }
+
+    // ==============================
+    // MAIN WINDOW INITIALIZATION:
+    // ==============================
+    // Signals and slots of every window are connected by its constructor.
+    // Windows opened later by the page share the browser engine,
+    // its caches and the script schedulers with the main window:
+    qint64 mainWindowSpan = QTraceRecorder::instance()->qNow();
+
+    QMainBrowserWindow *mainWindow = new QMainBrowserWindow();
+
+    QTraceRecorder::instance()->qComplete(
+                "startup", "view and page construction", mainWindowSpan);
+    mainWindow->setWindowIcon(icon);
+
+    QStartupMonitor::instance()->qEngineReadySlot();
+
+    // Resident mode keeps the browser running after
+    // the last window is closed:
+    if (resident == true) {
+        qApp->setProperty("openLabel", "Open");
+        qApp->setProperty("quitLabel", "Quit");
+
+        new QResidentMode();
+    }
+
+    // Signal and slot for the startup latency:
+    QObject::connect(mainWindow->webViewWidget->page(),
+                     SIGNAL(loadFinished(bool)),
+                     QStartupMonitor::instance(),
+                     SLOT(qPageLoadedSlot(bool)));
+
+    // Signal and slot for the timed and bounded shutdown:
+    QObject::connect(qApp, SIGNAL(aboutToQuit()),
+                     QShutdownCoordinator::instance(), SLOT(qExitSlot()));
+
+    // Signal and slot for actions taken before application exit:
+    QObject::connect(qApp, SIGNAL(aboutToQuit()),
+                     mainWindow, SLOT(qExitApplicationSlot()));
+
+    // ==============================
+    // First page:
+    // ==============================
+    // Local file:
+    if (startPageFile.exists()) {
+        mainWindow->webViewWidget->setUrl(
+                    QUrl::fromLocalFile(startPageFilePath));
+    }
+
+    // Local server:
+    if (serverStarter != NULL) {
+        // Signals and slots for loading of the local server URL:
+        QObject::connect(serverStarter, SIGNAL(loadUrlSignal(QUrl)),
+                         QStartupMonitor::instance(),
+                         SLOT(qLocalServerReadySlot()));
 
-        // Signal and slot for loading of the local server URL:
         QObject::connect(serverStarter, SIGNAL(loadUrlSignal(QUrl)),
-                         &mainWindow, SLOT(qLoadUrlSlot(QUrl)));
+                         mainWindow, SLOT(qLoadUrlSlot(QUrl)));
 
         // Signal and slot for displaying local server configuration errors:
         QObject::connect(serverStarter, SIGNAL(displayErrorSignal(QString)),
-                         &mainWindow, SLOT(qDisplayErrorSlot(QString)));
+                         mainWindow, SLOT(qDisplayErrorSlot(QString)));
+
+        // Signal and slot for reloading the page after a local server restart:
+        QObject::connect(serverStarter, SIGNAL(localServerRestartedSignal()),
+                         mainWindow->webViewWidget, SLOT(reload()));
     }
 
     // No start file:
     if (startFileFound == false) {
-        mainWindow.qDisplayErrorSlot(
+        mainWindow->qDisplayErrorSlot(
                     QString("No start page or local server is found."));
     }
 
-    return application.exec();
+    int exitCode = application.exec();
+
+    QTraceRecorder::instance()->qClose();
+
+    return exitCode;
 }
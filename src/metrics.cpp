@@ -0,0 +1,329 @@
+/*
+ Perl Executing Browser
+
+ This program is free software;
+ you can redistribute it and/or modify it under the terms of the
+ GNU Lesser General Public License,
+ as published by the Free Software Foundation;
+ either version 3 of the License, or (at your option) any later version.
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY;
+ without even the implied warranty of MERCHANTABILITY or
+ FITNESS FOR A PARTICULAR PURPOSE.
+ Dimitar D. Mitov, 2013 - 2019
+ Valcho Nedelchev, 2014 - 2016
+ https://github.com/ddmitov/perl-executing-browser
+*/
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QJsonObject>
+#include <QSaveFile>
+
+#include "metrics.h"
+#include "script-scheduler.h"
+
+// Requests of the metrics port are limited to 4 KB:
+#define METRICS_REQUEST_LIMIT 4096
+
+// ==============================
+// METRICS CONSTRUCTOR:
+// ==============================
+QMetrics::QMetrics()
+    : QObject(0)
+{
+    enabled = false;
+
+    bridgeCalls = 0;
+    deliveries = 0;
+    deliveredBytes = 0;
+    outputBacklog = 0;
+
+    metricsServer = NULL;
+    exportTimer = NULL;
+    lagTimer = NULL;
+
+    lagInterval = 250;
+    lagMaximum = 0;
+    reportedLag = 0;
+}
+
+QMetrics *QMetrics::instance()
+{
+    static QMetrics *metrics = new QMetrics();
+    return metrics;
+}
+
+void QMetrics::qStart(bool file, int port, int interval)
+{
+    if (enabled == true or (file == false and port <= 0)) {
+        return;
+    }
+
+    enabled = true;
+
+    // The text file collector of the Prometheus node exporter
+    // reads files with the .prom extension replaced atomically:
+    if (file == true) {
+        metricsFilePath =
+                QString::fromLatin1(qgetenv("PEB_DATA_DIR")) + "/metrics.prom";
+    }
+
+    if (port > 0) {
+        metricsServer = new QTcpServer(this);
+
+        if (!metricsServer->listen(QHostAddress::LocalHost, port)) {
+            qDebug("Metrics port %d is not available.", port);
+        }
+
+        QObject::connect(metricsServer, SIGNAL(newConnection()),
+                         this, SLOT(qNewConnectionSlot()));
+    }
+
+    // The event loop lag is sampled several times per second and
+    // its maximum is reported for every export interval:
+    lagTimer = new QTimer(this);
+    lagTimer->setTimerType(Qt::PreciseTimer);
+
+    QObject::connect(lagTimer, SIGNAL(timeout()), this, SLOT(qLagSlot()));
+
+    lagClock.start();
+    lagTimer->start(lagInterval);
+
+    exportTimer = new QTimer(this);
+
+    QObject::connect(exportTimer, SIGNAL(timeout()),
+                     this, SLOT(qExportSlot()));
+
+    exportTimer->start(qMax(1, interval) * 1000);
+}
+
+// ==============================
+// Export:
+// ==============================
+void QMetrics::qExportSlot()
+{
+    reportedLag = lagMaximum;
+    lagMaximum = 0;
+
+    if (metricsFilePath.length() > 0) {
+        QSaveFile metricsFile(metricsFilePath);
+
+        if (metricsFile.open(QIODevice::WriteOnly)) {
+            metricsFile.write(qReport().toUtf8());
+            metricsFile.commit();
+        }
+    }
+}
+
+void QMetrics::qReadRequestSlot()
+{
+    QTcpSocket *client = qobject_cast<QTcpSocket*>(sender());
+
+    if (client == NULL) {
+        return;
+    }
+
+    // The whole request header is read before the response,
+    // so that the connection is not reset when it is closed:
+    QByteArray request =
+            client->property("request").toByteArray() + client->readAll();
+
+    if (!request.contains("\r\n\r\n")) {
+        // Scrapers send short requests and
+        // connections sending more are dropped:
+        if (request.size() > METRICS_REQUEST_LIMIT) {
+            client->abort();
+            return;
+        }
+
+        client->setProperty("request", request);
+        return;
+    }
+
+    QByteArray response;
+
+    if (request.startsWith("GET ")) {
+        QByteArray report = qReport().toUtf8();
+
+        response = "HTTP/1.1 200 OK\r\n"
+                   "Content-Type: application/openmetrics-text; "
+                   "version=1.0.0; charset=utf-8\r\n"
+                   "Content-Length: " + QByteArray::number(report.size()) +
+                   "\r\n"
+                   "Connection: close\r\n\r\n" + report;
+    } else {
+        response = "HTTP/1.1 405 Method Not Allowed\r\n"
+                   "Content-Length: 0\r\n"
+                   "Connection: close\r\n\r\n";
+    }
+
+    client->write(response);
+    client->disconnectFromHost();
+}
+
+// ==============================
+// OpenMetrics text format:
+// ==============================
+static QString qMetric(QString name, QString type, QString unit,
+                       QString help, QString value)
+{
+    QString sample = name;
+    if (type == "counter") {
+        sample.append("_total");
+    }
+
+    QString metric = "# TYPE " + name + " " + type + "\n";
+
+    if (unit.length() > 0) {
+        metric.append("# UNIT " + name + " " + unit + "\n");
+    }
+
+    metric.append("# HELP " + name + " " + help + "\n");
+    metric.append(sample + " " + value + "\n");
+
+    return metric;
+}
+
+QString QMetrics::qReport()
+{
+    QJsonObject status = QScriptScheduler::instance()->qStatus(NULL);
+
+    QString report;
+
+    report.append(qMetric("peb_scripts_running", "gauge", "",
+                          "Perl scripts running in all windows.",
+                          QString::number(status["running"].toInt())));
+
+    report.append(qMetric("peb_scripts_queued", "gauge", "",
+                          "Perl scripts waiting for a free slot.",
+                          QString::number(status["queued"].toInt())));
+
+    report.append(qMetric("peb_bridge_calls", "counter", "",
+                          "Calls of the peb JavaScript API "
+                          "handled by the browser.",
+                          QString::number(bridgeCalls)));
+
+    report.append(qMetric("peb_script_deliveries", "counter", "",
+                          "Script output batches delivered to pages.",
+                          QString::number(deliveries)));
+
+    report.append(qMetric("peb_script_delivered_bytes", "counter", "bytes",
+                          "Bytes of script output delivered to pages.",
+                          QString::number(deliveredBytes)));
+
+    report.append(qMetric("peb_output_backlog_bytes", "gauge", "bytes",
+                          "Script output held back from hidden or "
+                          "frozen pages.",
+                          QString::number(outputBacklog)));
+
+    report.append(qMetric("peb_local_server_restarts", "counter", "",
+                          "Restarts of local server instances.",
+                          QString::number(qApp->property(
+                                              "localServerRestarts")
+                                          .toInt())));
+
+    report.append(qMetric("peb_event_loop_lag_seconds", "gauge", "seconds",
+                          "Maximum delay of the GUI event loop "
+                          "in the latest export interval.",
+                          QString::number(qMax(reportedLag, lagMaximum) /
+                                          1000.0)));
+
+#ifdef Q_OS_LINUX
+    report.append(qMetric("peb_resident_memory_bytes", "gauge", "bytes",
+                          "Resident memory of the browser process.",
+                          QString::number(qResidentMemory(
+                                              QCoreApplication::
+                                              applicationPid()))));
+
+#if QT_VERSION > QT_VERSION_CHECK(5, 5, 0)
+#if ANNULEN_QTWEBKIT == 0
+    report.append(qMetric("peb_renderer_memory_bytes", "gauge", "bytes",
+                          "Resident memory of the renderer and "
+                          "other browser engine processes.",
+                          QString::number(qRendererMemory())));
+#endif
+#endif
+#endif
+
+    report.append("# EOF\n");
+
+    return report;
+}
+
+// ==============================
+// Process memory:
+// ==============================
+qint64 QMetrics::qResidentMemory(qint64 processId)
+{
+    qint64 residentMemory = 0;
+
+    QFile processStatus("/proc/" + QString::number(processId) + "/status");
+
+    if (processStatus.open(QIODevice::ReadOnly)) {
+        foreach (QByteArray line, processStatus.readAll().split('\n')) {
+            if (line.startsWith("VmRSS:")) {
+                residentMemory =
+                        line.mid(6).replace("kB", "").trimmed().toLongLong() *
+                        1024;
+            }
+        }
+    }
+
+    return residentMemory;
+}
+
+qint64 QMetrics::qRendererMemory()
+{
+    qint64 rendererMemory = 0;
+
+#ifdef Q_OS_LINUX
+    // Renderer processes are started by the zygote process of
+    // the browser engine, so only the children of PEB and
+    // of browser engine processes are read from their task directories:
+    QList<qint64> parentProcesses;
+    parentProcesses.append(QCoreApplication::applicationPid());
+
+    while (!parentProcesses.isEmpty()) {
+        QString taskDirectory =
+                "/proc/" + QString::number(parentProcesses.takeFirst()) +
+                "/task";
+
+        foreach (QString task,
+                 QDir(taskDirectory).entryList(
+                     QDir::Dirs | QDir::NoDotAndDotDot)) {
+            QFile children(taskDirectory + "/" + task + "/children");
+
+            if (!children.open(QIODevice::ReadOnly)) {
+                continue;
+            }
+
+            foreach (QByteArray child,
+                     children.readAll().simplified().split(' ')) {
+                qint64 childProcess = child.toLongLong();
+
+                if (childProcess <= 0) {
+                    continue;
+                }
+
+                QFile processName(
+                            "/proc/" + QString::number(childProcess) +
+                            "/comm");
+
+                if (!processName.open(QIODevice::ReadOnly)) {
+                    continue;
+                }
+
+                // Command names are truncated to 15 characters:
+                if (processName.readAll().startsWith("QtWebEngineProc")) {
+                    rendererMemory += qResidentMemory(childProcess);
+                    parentProcesses.append(childProcess);
+                }
+            }
+        }
+    }
+#endif
+
+    return rendererMemory;
+}
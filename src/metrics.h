@@ -0,0 +1,97 @@
+/*
+ Perl Executing Browser
+
+ This program is free software;
+ you can redistribute it and/or modify it under the terms of the
+ GNU Lesser General Public License,
+ as published by the Free Software Foundation;
+ either version 3 of the License, or (at your option) any later version.
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY;
+ without even the implied warranty of MERCHANTABILITY or
+ FITNESS FOR A PARTICULAR PURPOSE.
+ Dimitar D. Mitov, 2013 - 2019
+ Valcho Nedelchev, 2014 - 2016
+ https://github.com/ddmitov/perl-executing-browser
+*/
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <QElapsedTimer>
+#include <QObject>
+#include <QString>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTimer>
+
+// ==============================
+// METRICS CLASS DEFINITION:
+// Process-wide counters and gauges in the OpenMetrics text format
+// written to a file or served on a loopback port
+// ==============================
+class QMetrics : public QObject
+{
+    Q_OBJECT
+
+public slots:
+    void qExportSlot();
+
+    void qNewConnectionSlot()
+    {
+        while (metricsServer->hasPendingConnections()) {
+            QTcpSocket *client = metricsServer->nextPendingConnection();
+
+            QObject::connect(client, SIGNAL(readyRead()),
+                             this, SLOT(qReadRequestSlot()));
+            QObject::connect(client, SIGNAL(disconnected()),
+                             client, SLOT(deleteLater()));
+        }
+    }
+
+    void qReadRequestSlot();
+
+    void qLagSlot()
+    {
+        // Lag is the delay of a timer event behind its schedule:
+        qint64 lag = lagClock.restart() - lagInterval;
+        lagMaximum = qMax(lagMaximum, lag);
+    }
+
+public:
+    static QMetrics *instance();
+
+    // Metrics are collected only after the export is started.
+    // The export interval is set in seconds:
+    void qStart(bool file, int port, int interval);
+
+    QString qReport();
+
+    bool enabled;
+
+    // Counters:
+    qint64 bridgeCalls;
+    qint64 deliveries;
+    qint64 deliveredBytes;
+
+    // Gauges:
+    qint64 outputBacklog;
+
+private:
+    QMetrics();
+
+    static qint64 qResidentMemory(qint64 processId);
+    qint64 qRendererMemory();
+
+    QString metricsFilePath;
+    QTcpServer *metricsServer;
+    QTimer *exportTimer;
+
+    QTimer *lagTimer;
+    QElapsedTimer lagClock;
+    int lagInterval;
+    qint64 lagMaximum;
+    qint64 reportedLag;
+};
+
+#endif // METRICS_H
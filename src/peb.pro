@@ -84,6 +84,19 @@ greaterThan (QT_MAJOR_VERSION, 4) {
     # Network support:
     QT += network
 
+    # USDT probes:
+    linux {
+        exists (/usr/include/sys/sdt.h) {
+            DEFINES += PEB_USDT_PROBES
+            message ("Configured with USDT probes.")
+        }
+    }
+
+    # Screen lock notifications:
+    linux {
+        QT += dbus
+    }
+
     # HTTPS support:
     CONFIG += openssl-linked
 
@@ -117,20 +130,49 @@ greaterThan (QT_MAJOR_VERSION, 4) {
         # Source files:
         SOURCES += \
             main.cpp \
+            child-process.cpp \
+            background-monitor.cpp \
             file-reader.cpp \
+            instance-server.cpp \
+            load-balancer.cpp \
             main-window.cpp \
+            metrics.cpp \
+            periodic-scheduler.cpp \
             port-scanner.cpp \
+            request-statistics.cpp \
+            resident-mode.cpp \
             server-starter.cpp \
+            shutdown-coordinator.cpp \
+            stall-watchdog.cpp \
+            startup-monitor.cpp \
             script-handler.cpp \
+            script-scheduler.cpp \
+            timer-wheel.cpp \
+            trace-recorder.cpp \
             webkit-page.cpp \
             webkit-view.cpp
 
         # Header files:
         HEADERS += \
+            background-monitor.h \
+            child-process.h \
             file-reader.h \
+            instance-server.h \
+            load-balancer.h \
+            metrics.h \
+            periodic-scheduler.h \
             port-scanner.h \
+            probes.h \
+            request-statistics.h \
+            resident-mode.h \
             server-starter.h \
+            shutdown-coordinator.h \
+            stall-watchdog.h \
+            startup-monitor.h \
             script-handler.h \
+            script-scheduler.h \
+            timer-wheel.h \
+            trace-recorder.h \
             webkit-main-window.h \
             webkit-page.h \
             webkit-view.h
@@ -141,20 +183,53 @@ greaterThan (QT_MAJOR_VERSION, 4) {
             # Source files:
             SOURCES += \
                 main.cpp \
+                child-process.cpp \
+                background-monitor.cpp \
+                fastcgi-handler.cpp \
                 file-reader.cpp \
+                instance-server.cpp \
+                load-balancer.cpp \
                 main-window.cpp \
+                metrics.cpp \
+                periodic-scheduler.cpp \
                 port-scanner.cpp \
+                request-statistics.cpp \
+                resident-mode.cpp \
+                response-cache.cpp \
                 server-starter.cpp \
+                shutdown-coordinator.cpp \
+                stall-watchdog.cpp \
+                startup-monitor.cpp \
                 script-handler.cpp \
+                script-scheduler.cpp \
+                timer-wheel.cpp \
+                trace-recorder.cpp \
                 webengine-page.cpp \
                 webengine-view.cpp
 
             # Header files:
             HEADERS += \
+                background-monitor.h \
+                child-process.h \
+                fastcgi-handler.h \
                 file-reader.h \
+                instance-server.h \
+                load-balancer.h \
+                metrics.h \
+                periodic-scheduler.h \
                 port-scanner.h \
+                probes.h \
+                request-statistics.h \
+                resident-mode.h \
+                response-cache.h \
                 server-starter.h \
+                shutdown-coordinator.h \
+                stall-watchdog.h \
+                startup-monitor.h \
                 script-handler.h \
+                script-scheduler.h \
+                timer-wheel.h \
+                trace-recorder.h \
                 webengine-main-window.h \
                 webengine-page.h \
                 webengine-view.h
@@ -164,20 +239,49 @@ greaterThan (QT_MAJOR_VERSION, 4) {
             # Source files:
             SOURCES += \
                 main.cpp \
+                child-process.cpp \
+                background-monitor.cpp \
                 file-reader.cpp \
+                instance-server.cpp \
+                load-balancer.cpp \
                 main-window.cpp \
+                metrics.cpp \
+                periodic-scheduler.cpp \
                 port-scanner.cpp \
+                request-statistics.cpp \
+                resident-mode.cpp \
                 server-starter.cpp \
+                shutdown-coordinator.cpp \
+                stall-watchdog.cpp \
+                startup-monitor.cpp \
                 script-handler.cpp \
+                script-scheduler.cpp \
+                timer-wheel.cpp \
+                trace-recorder.cpp \
                 webkit-page.cpp \
                 webkit-view.cpp
 
             # Header files:
             HEADERS += \
+                background-monitor.h \
+                child-process.h \
                 file-reader.h \
+                instance-server.h \
+                load-balancer.h \
+                metrics.h \
+                periodic-scheduler.h \
                 port-scanner.h \
+                probes.h \
+                request-statistics.h \
+                resident-mode.h \
                 server-starter.h \
+                shutdown-coordinator.h \
+                stall-watchdog.h \
+                startup-monitor.h \
                 script-handler.h \
+                script-scheduler.h \
+                timer-wheel.h \
+                trace-recorder.h \
                 webkit-main-window.h \
                 webkit-page.h \
                 webkit-view.h
@@ -0,0 +1,364 @@
+/*
+ Perl Executing Browser
+
+ This program is free software;
+ you can redistribute it and/or modify it under the terms of the
+ GNU Lesser General Public License,
+ as published by the Free Software Foundation;
+ either version 3 of the License, or (at your option) any later version.
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY;
+ without even the implied warranty of MERCHANTABILITY or
+ FITNESS FOR A PARTICULAR PURPOSE.
+ Dimitar D. Mitov, 2013 - 2019
+ Valcho Nedelchev, 2014 - 2016
+ https://github.com/ddmitov/perl-executing-browser
+*/
+
+#include <QMetaObject>
+#include <QStringList>
+#include <QtGlobal>
+
+#if QT_VERSION >= QT_VERSION_CHECK(5, 10, 0)
+#include <QRandomGenerator>
+#else
+#include <cstdlib>
+#endif
+
+#include "periodic-scheduler.h"
+#include "timer-wheel.h"
+
+// ==============================
+// PERIODIC JOB CONSTRUCTOR:
+// ==============================
+QPeriodicJob::QPeriodicJob(QObject *jobPage, QString jobScriptId)
+    : QObject(0)
+{
+    page = jobPage;
+    scriptId = jobScriptId;
+
+    interval = 0;
+    offset = 0;
+    resident = false;
+
+    runs = 0;
+    skippedRuns = 0;
+
+    timeoutId = 0;
+    scheduledRun = 0;
+}
+
+void QPeriodicJob::qScheduleNextRun()
+{
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+    qint64 nextRun = 0;
+
+    // The next run follows the previous scheduled run even if
+    // the previous tick came early, so that no run is scheduled twice:
+    qint64 previousRun = qMax(now, scheduledRun);
+
+    // Interval runs are aligned to multiples of the interval, so that
+    // jobs with equal intervals are woken up together by the timer wheel.
+    // Runs missed during a suspend or a busy period are not repeated.
+    if (interval > 0) {
+        nextRun = (previousRun / interval + 1) * interval;
+    }
+
+    if (schedule.length() > 0) {
+        QDateTime nextCronRun = QPeriodicScheduler::qNextCronRun(
+                    schedule, QDateTime::fromMSecsSinceEpoch(previousRun));
+
+        if (!nextCronRun.isValid()) {
+            return;
+        }
+
+        nextRun = nextCronRun.toMSecsSinceEpoch();
+    }
+
+    scheduledRun = nextRun;
+
+    // The fixed offset of every job spreads the starts of
+    // many jobs due at the same time:
+    timeoutId = QTimerWheel::instance()->qSchedule(
+                this, "qTickSlot", nextRun + offset - now);
+}
+
+void QPeriodicJob::qStop()
+{
+    QTimerWheel::instance()->qCancel(timeoutId);
+    timeoutId = 0;
+}
+
+void QPeriodicJob::qTickSlot()
+{
+    timeoutId = 0;
+
+    if (page.isNull()) {
+        return;
+    }
+
+    runs++;
+
+    // The next run is scheduled first, because
+    // the page may stop the job during its tick:
+    qScheduleNextRun();
+
+    QMetaObject::invokeMethod(page, "qPeriodicTickSlot",
+                              Q_ARG(QString, scriptId));
+}
+
+// ==============================
+// PERIODIC SCHEDULER CONSTRUCTOR:
+// ==============================
+QPeriodicScheduler::QPeriodicScheduler()
+    : QObject(0)
+{
+#if QT_VERSION < QT_VERSION_CHECK(5, 10, 0)
+    qsrand(uint(QDateTime::currentMSecsSinceEpoch()));
+#endif
+}
+
+QPeriodicScheduler *QPeriodicScheduler::instance()
+{
+    static QPeriodicScheduler *periodicScheduler = new QPeriodicScheduler();
+    return periodicScheduler;
+}
+
+// ==============================
+// Jobs:
+// ==============================
+bool QPeriodicScheduler::qRegister(QObject *page,
+                                   QJsonObject scriptJsonObject)
+{
+    QString scriptId = scriptJsonObject["id"].toString();
+
+    if (qJob(page, scriptId) != NULL) {
+        return false;
+    }
+
+    QPeriodicJob *job = new QPeriodicJob(page, scriptId);
+    job->interval = qRound64(scriptJsonObject["interval"].toDouble() * 1000);
+    job->schedule = scriptJsonObject["schedule"].toString();
+    job->resident = scriptJsonObject["resident"].toBool(false);
+
+    if (job->interval <= 0 and job->schedule.length() == 0) {
+        delete job;
+        return false;
+    }
+
+    // The default jitter is 5 percent of the interval up to one second:
+    qint64 jitter = qMin(job->interval / 20, qint64(1000));
+
+    if (scriptJsonObject.contains("jitter")) {
+        jitter = qRound64(scriptJsonObject["jitter"].toDouble() * 1000);
+    }
+
+    if (jitter > 0) {
+#if QT_VERSION >= QT_VERSION_CHECK(5, 10, 0)
+        job->offset =
+                QRandomGenerator::global()->bounded(int(jitter) + 1);
+#else
+        job->offset = qint64(double(qrand()) / RAND_MAX * jitter);
+#endif
+    }
+
+    jobs.append(job);
+    job->qScheduleNextRun();
+
+    return true;
+}
+
+QPeriodicJob *QPeriodicScheduler::qJob(QObject *page, QString scriptId)
+{
+    foreach (QPeriodicJob *job, jobs) {
+        if (job->page == page and job->scriptId == scriptId) {
+            return job;
+        }
+    }
+
+    return NULL;
+}
+
+bool QPeriodicScheduler::qHasJobs(QObject *page)
+{
+    foreach (QPeriodicJob *job, jobs) {
+        if (job->page == page) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void QPeriodicScheduler::qUnregister(QObject *page, QString scriptId)
+{
+    QPeriodicJob *job = qJob(page, scriptId);
+
+    if (job != NULL) {
+        jobs.removeAll(job);
+        job->qStop();
+        job->deleteLater();
+    }
+}
+
+void QPeriodicScheduler::qRemovePage(QObject *page)
+{
+    foreach (QPeriodicJob *job, jobs) {
+        if (job->page == page or job->page.isNull()) {
+            jobs.removeAll(job);
+            job->qStop();
+            job->deleteLater();
+        }
+    }
+}
+
+// ==============================
+// Cron schedules:
+// ==============================
+static bool cronFieldValid(QString field, int minimum, int maximum)
+{
+    // Every part of a field is "*", a value or a range of values
+    // and can have a step after a slash:
+    foreach (QString part, field.split(',')) {
+        bool ok = true;
+
+        if (part.contains('/')) {
+            int step = part.section('/', 1).toInt(&ok);
+
+            if (ok == false or step <= 0) {
+                return false;
+            }
+
+            part = part.section('/', 0, 0);
+        }
+
+        if (part == "*") {
+            continue;
+        }
+
+        int first = part.section('-', 0, 0).toInt(&ok);
+
+        if (ok == false or first < minimum or first > maximum) {
+            return false;
+        }
+
+        if (part.contains('-')) {
+            int last = part.section('-', 1).toInt(&ok);
+
+            if (ok == false or last < first or last > maximum) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+static bool cronFieldMatches(QString field, int value, int minimum)
+{
+    foreach (QString part, field.split(',')) {
+        int step = 1;
+
+        if (part.contains('/')) {
+            step = part.section('/', 1, 1).toInt();
+            part = part.section('/', 0, 0);
+
+            if (step <= 0) {
+                return false;
+            }
+        }
+
+        int first = minimum;
+        int last = 9999;
+
+        if (part != "*") {
+            bool ok = false;
+            first = part.section('-', 0, 0).toInt(&ok);
+
+            if (ok == false) {
+                return false;
+            }
+
+            last = first;
+
+            if (part.contains('-')) {
+                last = part.section('-', 1, 1).toInt();
+            } else if (step > 1) {
+                last = 9999;
+            }
+        }
+
+        if (value >= first and value <= last and
+                (value - first) % step == 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+QDateTime QPeriodicScheduler::qNextCronRun(QString schedule, QDateTime after)
+{
+    QStringList fields = schedule.simplified().split(' ');
+
+    if (fields.length() != 5) {
+        return QDateTime();
+    }
+
+    // Fields are checked once, so that only valid fields are matched.
+    // Cron accepts both 0 and 7 for Sunday:
+    if (!cronFieldValid(fields[0], 0, 59) or
+            !cronFieldValid(fields[1], 0, 23) or
+            !cronFieldValid(fields[2], 1, 31) or
+            !cronFieldValid(fields[3], 1, 12) or
+            !cronFieldValid(fields[4], 0, 7)) {
+        return QDateTime();
+    }
+
+    QDateTime candidate = after.addSecs(60 - after.time().second());
+    candidate.setTime(QTime(candidate.time().hour(),
+                            candidate.time().minute()));
+
+    // Candidates up to one year later are checked and
+    // a schedule never matching in this year is not run:
+    QDateTime lastCandidate = after.addYears(1);
+
+    while (candidate <= lastCandidate) {
+        QDate date = candidate.date();
+        QTime time = candidate.time();
+
+        // Cron counts Sunday as 0 and Qt counts it as 7:
+        int dayOfWeek = date.dayOfWeek() % 7;
+
+        bool dayOfMonthMatches =
+                cronFieldMatches(fields[2], date.day(), 1);
+        bool dayOfWeekMatches =
+                cronFieldMatches(fields[4], dayOfWeek, 0) or
+                (dayOfWeek == 0 and cronFieldMatches(fields[4], 7, 0));
+
+        // If both day fields are restricted, either of them may match:
+        bool dayMatches = dayOfMonthMatches and dayOfWeekMatches;
+
+        if (fields[2] != "*" and fields[4] != "*") {
+            dayMatches = dayOfMonthMatches or dayOfWeekMatches;
+        }
+
+        if (dayMatches and
+                cronFieldMatches(fields[3], date.month(), 1) and
+                cronFieldMatches(fields[1], time.hour(), 0) and
+                cronFieldMatches(fields[0], time.minute(), 0)) {
+            return candidate;
+        }
+
+        // Hours and days not matching are skipped at once:
+        if (!dayMatches or !cronFieldMatches(fields[3], date.month(), 1)) {
+            candidate = QDateTime(date.addDays(1), QTime(0, 0));
+        } else if (!cronFieldMatches(fields[1], time.hour(), 0)) {
+            candidate = candidate.addSecs(60 * (60 - time.minute()));
+        } else {
+            candidate = candidate.addSecs(60);
+        }
+    }
+
+    return QDateTime();
+}
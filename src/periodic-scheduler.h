@@ -0,0 +1,90 @@
+/*
+ Perl Executing Browser
+
+ This program is free software;
+ you can redistribute it and/or modify it under the terms of the
+ GNU Lesser General Public License,
+ as published by the Free Software Foundation;
+ either version 3 of the License, or (at your option) any later version.
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY;
+ without even the implied warranty of MERCHANTABILITY or
+ FITNESS FOR A PARTICULAR PURPOSE.
+ Dimitar D. Mitov, 2013 - 2019
+ Valcho Nedelchev, 2014 - 2016
+ https://github.com/ddmitov/perl-executing-browser
+*/
+
+#ifndef PERIODIC_SCHEDULER_H
+#define PERIODIC_SCHEDULER_H
+
+#include <QDateTime>
+#include <QJsonObject>
+#include <QList>
+#include <QObject>
+#include <QPointer>
+#include <QString>
+
+// ==============================
+// PERIODIC JOB CLASS DEFINITION:
+// ==============================
+class QPeriodicJob : public QObject
+{
+    Q_OBJECT
+
+public slots:
+    void qTickSlot();
+
+public:
+    QPeriodicJob(QObject *jobPage, QString jobScriptId);
+
+    void qScheduleNextRun();
+    void qStop();
+
+    QPointer<QObject> page;
+    QString scriptId;
+
+    qint64 interval;
+    QString schedule;
+    qint64 offset;
+    bool resident;
+
+    qint64 runs;
+    qint64 skippedRuns;
+
+private:
+    quint64 timeoutId;
+    qint64 scheduledRun;
+};
+
+// ==============================
+// PERIODIC SCHEDULER CLASS DEFINITION:
+// Perl scripts started by PEB on a fixed interval or a cron schedule
+// ==============================
+class QPeriodicScheduler : public QObject
+{
+    Q_OBJECT
+
+public:
+    static QPeriodicScheduler *instance();
+
+    // Every page has a qPeriodicTickSlot(QString) slot
+    // called when one of its periodic scripts is due:
+    bool qRegister(QObject *page, QJsonObject scriptJsonObject);
+    QPeriodicJob *qJob(QObject *page, QString scriptId);
+    bool qHasJobs(QObject *page);
+    void qUnregister(QObject *page, QString scriptId);
+    void qRemovePage(QObject *page);
+
+    // The next time matching a schedule of five cron fields:
+    // minute, hour, day of month, month and day of week.
+    // An invalid date is returned if the schedule is malformed:
+    static QDateTime qNextCronRun(QString schedule, QDateTime after);
+
+private:
+    QPeriodicScheduler();
+
+    QList<QPeriodicJob*> jobs;
+};
+
+#endif // PERIODIC_SCHEDULER_H
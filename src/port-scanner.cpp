@@ -15,19 +15,22 @@
  https://github.com/ddmitov/perl-executing-browser
 */
 
-#include <QTcpSocket>
+#include <QHostAddress>
+#include <QTcpServer>
+
 #include "port-scanner.h"
 
 // ==============================
 // PORT SCANNER CONSTRUCTOR:
 // ==============================
-QPortScanner::QPortScanner(qint16 startPort, qint16 endPort)
+QPortScanner::QPortScanner(quint16 startPort, quint16 endPort)
     : QObject(0)
 {
     port = 0;
+    listeningSocket = new QTcpServer(this);
 
     // Google Chrome unsafe ports:
-    QHash<qint16, QString> unsafePorts;
+    QHash<quint16, QString> unsafePorts;
     unsafePorts.insert(2049, "nfs");
     unsafePorts.insert(3659, "apple-sasl / PasswordServer");
     unsafePorts.insert(4045, "lockd");
@@ -38,7 +41,16 @@ QPortScanner::QPortScanner(qint16 startPort, qint16 endPort)
     unsafePorts.insert(6668, "Alternate IRC [Apple addition]");
     unsafePorts.insert(6669, "Alternate IRC [Apple addition]");
 
-    if (startPort == endPort) {
+    // Port 0 means an ephemeral port assigned by the operating system:
+    if (startPort == 0) {
+        if (listeningSocket->listen(QHostAddress::LocalHost, 0)) {
+            port = listeningSocket->serverPort();
+        } else {
+            portScannerError = "No ephemeral port is available.";
+        }
+    }
+
+    if (startPort > 0 and startPort == endPort) {
         if (startPort <= 1024) {
             portScannerError = "Privileged ports (1 - 1024) can not be used.";
         }
@@ -51,15 +63,15 @@ QPortScanner::QPortScanner(qint16 startPort, qint16 endPort)
         }
     }
 
-    if (startPort < endPort) {
+    if (startPort > 0 and startPort < endPort) {
         if (startPort <= 1024) {
             startPort = 1025;
         }
     }
 
-    if (portScannerError.length() == 0) {
-        QList<qint16> safePorts;
-        for (quint16 testedPort = startPort;
+    if (startPort > 0 and portScannerError.length() == 0) {
+        QList<quint16> safePorts;
+        for (quint32 testedPort = startPort;
              testedPort <= endPort;
              testedPort++) {
             if (!unsafePorts.contains(testedPort)) {
@@ -67,14 +79,10 @@ QPortScanner::QPortScanner(qint16 startPort, qint16 endPort)
             }
         }
 
-        QTcpSocket *socket = new QTcpSocket();
-        foreach (qint16 safePort, safePorts) {
-            socket->bind(safePort, QAbstractSocket::DontShareAddress);
-            qint16 localPort = socket->localPort();
-            socket->close();
-            socket->deleteLater();
-
-            if (localPort == safePort) {
+        // The first safe port that can be bound on the loopback interface
+        // is kept open until the local server is started:
+        foreach (quint16 safePort, safePorts) {
+            if (listeningSocket->listen(QHostAddress::LocalHost, safePort)) {
                 port = safePort;
                 break;
             }
@@ -86,4 +94,10 @@ QPortScanner::QPortScanner(qint16 startPort, qint16 endPort)
                     QString::number(startPort) + " is in use.";
         }
     }
+
+    // Incoming connections are left in the backlog of the socket
+    // for the local server to accept them:
+    if (listeningSocket->isListening()) {
+        listeningSocket->pauseAccepting();
+    }
 }
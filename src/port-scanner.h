@@ -16,7 +16,7 @@
 */
 
 #include <QObject>
-#include <QTcpSocket>
+#include <QTcpServer>
 
 #ifndef PORT_SCANNER_H
 #define PORT_SCANNER_H
@@ -29,9 +29,14 @@ class QPortScanner : public QObject
     Q_OBJECT
 
 public:
-    explicit QPortScanner(qint16 startPort, qint16 endPort);
-    qint16 port;
+    explicit QPortScanner(quint16 startPort, quint16 endPort);
+    quint16 port;
     QString portScannerError;
+
+    // Loopback socket listening on the found port.
+    // It does not accept connections itself and
+    // can be passed to a local server or closed before the server starts.
+    QTcpServer *listeningSocket;
 };
 
 #endif // PORT_SCANNER_H
@@ -0,0 +1,45 @@
+/*
+ Perl Executing Browser
+
+ This program is free software;
+ you can redistribute it and/or modify it under the terms of the
+ GNU Lesser General Public License,
+ as published by the Free Software Foundation;
+ either version 3 of the License, or (at your option) any later version.
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY;
+ without even the implied warranty of MERCHANTABILITY or
+ FITNESS FOR A PARTICULAR PURPOSE.
+ Dimitar D. Mitov, 2013 - 2019
+ Valcho Nedelchev, 2014 - 2016
+ https://github.com/ddmitov/perl-executing-browser
+*/
+#ifndef PROBES_H
+#define PROBES_H
+
+// ==============================
+// USDT PROBES:
+// Static probes of the "peb" provider for bpftrace, perf and SystemTap.
+// A disabled probe is a single no-op instruction,
+// so only arguments already at hand are given to probes.
+// Probes are compiled only on Linux when <sys/sdt.h> is available.
+// ==============================
+#ifdef PEB_USDT_PROBES
+#include <sys/sdt.h>
+
+#define PEB_PROBE1(name, a1) \
+    DTRACE_PROBE1(peb, name, a1)
+#define PEB_PROBE2(name, a1, a2) \
+    DTRACE_PROBE2(peb, name, a1, a2)
+#define PEB_PROBE3(name, a1, a2, a3) \
+    DTRACE_PROBE3(peb, name, a1, a2, a3)
+#else
+#define PEB_PROBE1(name, a1) \
+    do {} while (0)
+#define PEB_PROBE2(name, a1, a2) \
+    do {} while (0)
+#define PEB_PROBE3(name, a1, a2, a3) \
+    do {} while (0)
+#endif
+
+#endif // PROBES_H
@@ -0,0 +1,371 @@
+/*
+ Perl Executing Browser
+
+ This program is free software;
+ you can redistribute it and/or modify it under the terms of the
+ GNU Lesser General Public License,
+ as published by the Free Software Foundation;
+ either version 3 of the License, or (at your option) any later version.
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY;
+ without even the implied warranty of MERCHANTABILITY or
+ FITNESS FOR A PARTICULAR PURPOSE.
+ Dimitar D. Mitov, 2013 - 2019
+ Valcho Nedelchev, 2014 - 2016
+ https://github.com/ddmitov/perl-executing-browser
+*/
+
+#include <QtWidgets/QApplication>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QRegularExpression>
+#include <QtMath>
+
+#include "request-statistics.h"
+
+// Every power of two is divided in 32 linear sub-buckets:
+#define SUB_BUCKETS 32
+#define SUB_BUCKET_BITS 5
+
+// ==============================
+// LATENCY HISTOGRAM CONSTRUCTOR:
+// ==============================
+QLatencyHistogram::QLatencyHistogram()
+{
+    count = 0;
+    minimum = 0;
+    maximum = 0;
+    total = 0;
+}
+
+static int histogramIndex(qint64 value)
+{
+    if (value < 2 * SUB_BUCKETS) {
+        return int(value);
+    }
+
+    int highestBit = 0;
+    while ((value >> (highestBit + 1)) > 0) {
+        highestBit++;
+    }
+
+    int exponent = highestBit - SUB_BUCKET_BITS;
+
+    return SUB_BUCKETS * exponent + int(value >> exponent);
+}
+
+static qint64 histogramValue(int index)
+{
+    if (index < 2 * SUB_BUCKETS) {
+        return index;
+    }
+
+    int exponent = index / SUB_BUCKETS - 1;
+    qint64 mantissa = index - SUB_BUCKETS * exponent;
+
+    // The highest value of the bucket is reported:
+    return ((mantissa + 1) << exponent) - 1;
+}
+
+void QLatencyHistogram::qRecord(qint64 value)
+{
+    if (value < 0) {
+        value = 0;
+    }
+
+    int index = histogramIndex(value);
+
+    if (index >= buckets.size()) {
+        buckets.resize(index + 1);
+    }
+
+    buckets[index]++;
+
+    if (count == 0 or value < minimum) {
+        minimum = value;
+    }
+
+    if (value > maximum) {
+        maximum = value;
+    }
+
+    count++;
+    total = total + value;
+}
+
+qint64 QLatencyHistogram::qPercentile(double percentile) const
+{
+    if (count == 0) {
+        return 0;
+    }
+
+    qint64 rank = qint64(qCeil(percentile / 100.0 * count));
+    qint64 seen = 0;
+
+    for (int index = 0; index < buckets.size(); index++) {
+        seen = seen + buckets[index];
+
+        if (seen >= rank) {
+            return qMin(histogramValue(index), maximum);
+        }
+    }
+
+    return maximum;
+}
+
+// ==============================
+// REQUEST STATISTICS:
+// ==============================
+// Resource Timing entries are read by a PerformanceObserver,
+// so that the Resource Timing buffer of the page is left untouched.
+// Older browser engines without PerformanceObserver
+// have only new entries of the buffer read:
+QString QRequestStatistics::resourceTimingsJavaScript = QString(
+        "(function () {"
+        "  if (!window.performance || !performance.getEntriesByType) {"
+        "    return '[]';"
+        "  }"
+        "  var entries = [];"
+        "  if (window.PerformanceObserver) {"
+        "    if (!window.pebResourceTimings) {"
+        "      window.pebResourceTimings = [];"
+        "      var observer = new PerformanceObserver(function (list) {"
+        "        window.pebResourceTimings ="
+        "          window.pebResourceTimings.concat(list.getEntries());"
+        "      });"
+        "      observer.observe({entryTypes: ['navigation', 'resource']});"
+        "      entries = performance.getEntriesByType('navigation').concat("
+        "        performance.getEntriesByType('resource'));"
+        "    }"
+        "    entries = entries.concat(window.pebResourceTimings);"
+        "    window.pebResourceTimings = [];"
+        "  } else {"
+        "    var resources = performance.getEntriesByType('resource');"
+        "    var collected = window.pebResourceTimingsCollected || 0;"
+        "    if (collected == 0) {"
+        "      entries = performance.getEntriesByType('navigation');"
+        "    }"
+        "    entries = entries.concat(resources.slice(collected));"
+        "    window.pebResourceTimingsCollected = resources.length;"
+        "  }"
+        "  return JSON.stringify(entries.map(function (entry) {"
+        "    return {"
+        "      name: entry.name,"
+        "      startTime: entry.startTime,"
+        "      requestStart: entry.requestStart,"
+        "      responseStart: entry.responseStart,"
+        "      responseEnd: entry.responseEnd,"
+        "      size: entry.encodedBodySize || 0"
+        "    };"
+        "  }));"
+        "})()");
+
+QRequestStatistics::QRequestStatistics()
+    : QObject(0)
+{
+}
+
+QRequestStatistics *QRequestStatistics::instance()
+{
+    static QRequestStatistics *requestStatistics = new QRequestStatistics();
+    return requestStatistics;
+}
+
+// ==============================
+// Routes:
+// ==============================
+QString QRequestStatistics::qRoute(QString method, QUrl url)
+{
+    // Numeric path segments are replaced, so that
+    // requests to one Perl handler are counted together:
+    QString path = url.path();
+    path.replace(QRegularExpression("/[0-9]+(?=/|$)"), "/#");
+
+    if (path.length() == 0) {
+        path = "/";
+    }
+
+    // Routes measured without a known method have only a path:
+    if (method.length() == 0) {
+        return path;
+    }
+
+    return method + " " + path;
+}
+
+void QRequestStatistics::qRecord(QString method,
+                                 QUrl url,
+                                 qint64 firstByteTime,
+                                 qint64 totalTime,
+                                 qint64 size)
+{
+    if (qApp->property("requestStatistics").toBool() == false) {
+        return;
+    }
+
+    QString route = qRoute(method, url);
+
+    if (!routes.contains(route)) {
+        QRouteStatistics routeStatistics;
+        routeStatistics.count = 0;
+        routeStatistics.bytes = 0;
+        routeStatistics.largestResponse = 0;
+        routes.insert(route, routeStatistics);
+    }
+
+    QRouteStatistics &routeStatistics = routes[route];
+
+    routeStatistics.count++;
+    routeStatistics.bytes = routeStatistics.bytes + size;
+    routeStatistics.largestResponse =
+            qMax(routeStatistics.largestResponse, size);
+    routeStatistics.firstByteTime.qRecord(firstByteTime);
+    routeStatistics.totalTime.qRecord(totalTime);
+}
+
+void QRequestStatistics::qRecordResourceTimings(QString entries)
+{
+    QString localServerBaseUrl =
+            qApp->property("local_server_base_url").toString();
+
+    if (localServerBaseUrl.length() == 0) {
+        return;
+    }
+
+    QJsonArray entriesArray =
+            QJsonDocument::fromJson(entries.toUtf8()).array();
+
+    foreach (QJsonValue value, entriesArray) {
+        QJsonObject entry = value.toObject();
+
+        // Only requests to the local server are recorded:
+        if (!entry["name"].toString().startsWith(localServerBaseUrl)) {
+            continue;
+        }
+
+        double startTime = entry["startTime"].toDouble();
+        double requestStart = entry["requestStart"].toDouble();
+        double responseStart = entry["responseStart"].toDouble();
+        double responseEnd = entry["responseEnd"].toDouble();
+
+        if (responseEnd <= 0) {
+            continue;
+        }
+
+        if (requestStart <= 0) {
+            requestStart = startTime;
+        }
+
+        // Resource Timing values are in milliseconds with fractions.
+        // Resource Timing entries do not expose the request method:
+        qRecord(QString(),
+                QUrl(entry["name"].toString()),
+                qRound64((responseStart - requestStart) * 1000),
+                qRound64((responseEnd - startTime) * 1000),
+                qint64(entry["size"].toDouble()));
+    }
+}
+
+// ==============================
+// Reports:
+// ==============================
+QString QRequestStatistics::qHtmlReport()
+{
+    QString report =
+            "<table cellpadding='3'>"
+            "<tr><th align='left'>Route</th><th>Requests</th>"
+            "<th>TTFB p50</th><th>TTFB p99</th>"
+            "<th>Total p50</th><th>Total p90</th><th>Total p99</th>"
+            "<th>Total max</th><th>Average size</th></tr>";
+
+    foreach (QString route, routes.keys()) {
+        const QRouteStatistics &routeStatistics = routes[route];
+
+        report.append(
+                    "<tr><td>" + route.toHtmlEscaped() + "</td>" +
+                    "<td align='right'>" +
+                    QString::number(routeStatistics.count) + "</td>");
+
+        QList<qint64> times;
+        times << routeStatistics.firstByteTime.qPercentile(50)
+              << routeStatistics.firstByteTime.qPercentile(99)
+              << routeStatistics.totalTime.qPercentile(50)
+              << routeStatistics.totalTime.qPercentile(90)
+              << routeStatistics.totalTime.qPercentile(99)
+              << routeStatistics.totalTime.maximum;
+
+        foreach (qint64 time, times) {
+            report.append("<td align='right'>" +
+                          QString::number(time / 1000.0, 'f', 1) +
+                          " ms</td>");
+        }
+
+        report.append(
+                    "<td align='right'>" +
+                    QString::number(routeStatistics.bytes /
+                                    routeStatistics.count) +
+                    " B</td></tr>");
+    }
+
+    report.append("</table>");
+
+    if (routes.isEmpty()) {
+        report = "No local server requests are recorded.";
+    }
+
+    return report;
+}
+
+bool QRequestStatistics::qWriteReport(QString filePath)
+{
+    QJsonArray routesArray;
+
+    foreach (QString route, routes.keys()) {
+        const QRouteStatistics &routeStatistics = routes[route];
+
+        QJsonObject routeObject;
+        routeObject["route"] = route;
+        routeObject["requests"] = double(routeStatistics.count);
+        routeObject["bytes"] = double(routeStatistics.bytes);
+        routeObject["largest_response"] =
+                double(routeStatistics.largestResponse);
+
+        QList<QPair<QString, const QLatencyHistogram*> > histograms;
+        histograms.append(qMakePair(QString("time_to_first_byte_us"),
+                                    &routeStatistics.firstByteTime));
+        histograms.append(qMakePair(QString("total_time_us"),
+                                    &routeStatistics.totalTime));
+
+        for (int index = 0; index < histograms.length(); index++) {
+            const QLatencyHistogram *histogram = histograms[index].second;
+
+            QJsonObject histogramObject;
+            histogramObject["min"] = double(histogram->minimum);
+            histogramObject["mean"] =
+                    double(histogram->total / qMax(histogram->count,
+                                                   qint64(1)));
+            histogramObject["p50"] = double(histogram->qPercentile(50));
+            histogramObject["p90"] = double(histogram->qPercentile(90));
+            histogramObject["p99"] = double(histogram->qPercentile(99));
+            histogramObject["p999"] = double(histogram->qPercentile(99.9));
+            histogramObject["max"] = double(histogram->maximum);
+
+            routeObject[histograms[index].first] = histogramObject;
+        }
+
+        routesArray.append(routeObject);
+    }
+
+    QFile reportFile(filePath);
+
+    if (!reportFile.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return false;
+    }
+
+    reportFile.write(QJsonDocument(routesArray).toJson());
+    reportFile.close();
+
+    return true;
+}
@@ -0,0 +1,98 @@
+/*
+ Perl Executing Browser
+
+ This program is free software;
+ you can redistribute it and/or modify it under the terms of the
+ GNU Lesser General Public License,
+ as published by the Free Software Foundation;
+ either version 3 of the License, or (at your option) any later version.
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY;
+ without even the implied warranty of MERCHANTABILITY or
+ FITNESS FOR A PARTICULAR PURPOSE.
+ Dimitar D. Mitov, 2013 - 2019
+ Valcho Nedelchev, 2014 - 2016
+ https://github.com/ddmitov/perl-executing-browser
+*/
+
+#ifndef REQUEST_STATISTICS_H
+#define REQUEST_STATISTICS_H
+
+#include <QMap>
+#include <QObject>
+#include <QString>
+#include <QUrl>
+#include <QVector>
+
+// ==============================
+// LATENCY HISTOGRAM DEFINITION:
+// Log-linear buckets with a relative error below 3 percent
+// in the style of HdrHistogram
+// ==============================
+class QLatencyHistogram
+{
+public:
+    QLatencyHistogram();
+
+    void qRecord(qint64 value);
+    qint64 qPercentile(double percentile) const;
+
+    qint64 count;
+    qint64 minimum;
+    qint64 maximum;
+    qint64 total;
+
+private:
+    QVector<qint64> buckets;
+};
+
+// ==============================
+// ROUTE STATISTICS DEFINITION:
+// ==============================
+struct QRouteStatistics
+{
+    qint64 count;
+    qint64 bytes;
+    qint64 largestResponse;
+
+    // Times are recorded in microseconds:
+    QLatencyHistogram firstByteTime;
+    QLatencyHistogram totalTime;
+};
+
+// ==============================
+// REQUEST STATISTICS CLASS DEFINITION:
+// Per-route latency and size statistics of local server requests
+// ==============================
+class QRequestStatistics : public QObject
+{
+    Q_OBJECT
+
+public:
+    static QRequestStatistics *instance();
+
+    void qRecord(QString method,
+                 QUrl url,
+                 qint64 firstByteTime,
+                 qint64 totalTime,
+                 qint64 size);
+
+    // Resource Timing entries collected from a page as a JSON array:
+    void qRecordResourceTimings(QString entries);
+
+    QString qHtmlReport();
+    bool qWriteReport(QString filePath);
+
+    // JavaScript code returning all Resource Timing entries
+    // not collected before as a JSON array:
+    static QString resourceTimingsJavaScript;
+
+private:
+    QRequestStatistics();
+
+    static QString qRoute(QString method, QUrl url);
+
+    QMap<QString, QRouteStatistics> routes;
+};
+
+#endif // REQUEST_STATISTICS_H
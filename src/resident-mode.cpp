@@ -0,0 +1,106 @@
+/*
+ Perl Executing Browser
+
+ This program is free software;
+ you can redistribute it and/or modify it under the terms of the
+ GNU Lesser General Public License,
+ as published by the Free Software Foundation;
+ either version 3 of the License, or (at your option) any later version.
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY;
+ without even the implied warranty of MERCHANTABILITY or
+ FITNESS FOR A PARTICULAR PURPOSE.
+ Dimitar D. Mitov, 2013 - 2019
+ Valcho Nedelchev, 2014 - 2016
+ https://github.com/ddmitov/perl-executing-browser
+*/
+#include <QtWidgets/QApplication>
+
+#include "resident-mode.h"
+
+#if QT_VERSION < QT_VERSION_CHECK(5, 6, 0)
+#include "webkit-main-window.h"
+#endif
+
+#if QT_VERSION > QT_VERSION_CHECK(5, 5, 0)
+#if ANNULEN_QTWEBKIT == 0
+#include "webengine-main-window.h"
+#endif
+
+#if ANNULEN_QTWEBKIT == 1
+#include "webkit-main-window.h"
+#endif
+#endif
+
+// ==============================
+// RESIDENT MODE CONSTRUCTOR:
+// ==============================
+QResidentMode::QResidentMode()
+    : QObject(qApp)
+{
+    // Closing the last window closes only the scripts of its page.
+    // The local server and the browser engine are stopped on quit:
+    qApp->setQuitOnLastWindowClosed(false);
+
+    trayIcon = NULL;
+    trayMenu = NULL;
+
+    // Without a system tray the running instance is reached
+    // only by a later launch in single instance mode:
+    if (QSystemTrayIcon::isSystemTrayAvailable()) {
+        trayMenu = new QMenu();
+
+        QAction *openAction = trayMenu->addAction(
+                    qApp->property("openLabel").toString());
+        QObject::connect(openAction, SIGNAL(triggered()),
+                         this, SLOT(qOpenWindowSlot()));
+
+        QAction *quitAction = trayMenu->addAction(
+                    qApp->property("quitLabel").toString());
+        QObject::connect(quitAction, SIGNAL(triggered()),
+                         this, SLOT(qQuitSlot()));
+
+        trayIcon = new QSystemTrayIcon(QApplication::windowIcon(), this);
+        trayIcon->setContextMenu(trayMenu);
+        trayIcon->setToolTip(QApplication::applicationName());
+
+        QObject::connect(
+                    trayIcon,
+                    SIGNAL(activated(QSystemTrayIcon::ActivationReason)),
+                    this,
+                    SLOT(qTrayActivatedSlot(
+                             QSystemTrayIcon::ActivationReason)));
+
+        trayIcon->show();
+    }
+}
+
+// ==============================
+// Tray actions:
+// ==============================
+void QResidentMode::qOpenWindowSlot()
+{
+    QMainBrowserWindow::qShowWindow(QUrl());
+}
+
+void QResidentMode::qQuitSlot()
+{
+    // Every window closes the scripts of its page and
+    // the application quits after the last window is closed:
+    qApp->setQuitOnLastWindowClosed(true);
+
+    bool windowsOpen = false;
+
+    foreach (QWidget *widget, QApplication::topLevelWidgets()) {
+        QMainBrowserWindow *window = qobject_cast<QMainBrowserWindow*>(widget);
+
+        if (window != NULL and window->isVisible()) {
+            windowsOpen = true;
+            window->close();
+        }
+    }
+
+    if (windowsOpen == false) {
+        QApplication::quit();
+    }
+}
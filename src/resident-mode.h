@@ -0,0 +1,54 @@
+/*
+ Perl Executing Browser
+
+ This program is free software;
+ you can redistribute it and/or modify it under the terms of the
+ GNU Lesser General Public License,
+ as published by the Free Software Foundation;
+ either version 3 of the License, or (at your option) any later version.
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY;
+ without even the implied warranty of MERCHANTABILITY or
+ FITNESS FOR A PARTICULAR PURPOSE.
+ Dimitar D. Mitov, 2013 - 2019
+ Valcho Nedelchev, 2014 - 2016
+ https://github.com/ddmitov/perl-executing-browser
+*/
+#ifndef RESIDENT_MODE_H
+#define RESIDENT_MODE_H
+
+#include <QAction>
+#include <QMenu>
+#include <QObject>
+#include <QSystemTrayIcon>
+
+// ==============================
+// RESIDENT MODE CLASS DEFINITION:
+// Browser process, local server and caches kept alive
+// after the last window is closed
+// ==============================
+class QResidentMode : public QObject
+{
+    Q_OBJECT
+
+public slots:
+    void qTrayActivatedSlot(QSystemTrayIcon::ActivationReason reason)
+    {
+        if (reason == QSystemTrayIcon::Trigger or
+                reason == QSystemTrayIcon::DoubleClick) {
+            qOpenWindowSlot();
+        }
+    }
+
+    void qOpenWindowSlot();
+    void qQuitSlot();
+
+public:
+    explicit QResidentMode();
+
+private:
+    QSystemTrayIcon *trayIcon;
+    QMenu *trayMenu;
+};
+
+#endif // RESIDENT_MODE_H
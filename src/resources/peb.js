@@ -3,7 +3,13 @@ var peb = {};
 
 peb.getPageSettings = function() {
   if (window[pebSettings] !== null) {
-    return JSON.stringify(pebSettings);
+    // Functions are reported only as present:
+    return JSON.stringify(pebSettings, function(key, value) {
+      if (key === 'scriptQueueFunction') {
+        return typeof value === 'function';
+      }
+      return value;
+    });
   }
 }
 
@@ -32,6 +38,104 @@ peb.startScript = function(scriptSettings) {
   form.submit();
 }
 
+peb.cancel = function(scriptSettings) {
+  var form = document.createElement('form');
+  form.setAttribute('action', scriptSettings + '.cancel');
+  document.body.appendChild(form);
+  form.submit();
+}
+
+peb.scriptStats = {};
+peb.scriptStatsCallbacks = {};
+
+peb.stats = function(scriptSettings, callback) {
+  var stats = peb.scriptStats[scriptSettings];
+
+  if (stats && stats.state === 'finished') {
+    if (typeof callback === 'function') {
+      callback(stats);
+    }
+    return stats;
+  }
+
+  if (typeof callback === 'function') {
+    if (!peb.scriptStatsCallbacks[scriptSettings]) {
+      peb.scriptStatsCallbacks[scriptSettings] = [];
+    }
+    peb.scriptStatsCallbacks[scriptSettings].push(callback);
+  }
+
+  var form = document.createElement('form');
+  form.setAttribute('action', scriptSettings + '.stats');
+  document.body.appendChild(form);
+  form.submit();
+
+  return stats;
+}
+
+peb.receiveStats = function(scriptId, stats) {
+  peb.scriptStats[scriptId] = stats;
+
+  var callbacks = peb.scriptStatsCallbacks[scriptId] || [];
+  delete peb.scriptStatsCallbacks[scriptId];
+
+  for (var index = 0; index < callbacks.length; index++) {
+    callbacks[index](stats);
+  }
+
+  if (stats.state === 'finished' && window[scriptId] &&
+      typeof window[scriptId].statsFunction === 'function') {
+    window[scriptId].statsFunction(stats);
+  }
+}
+
+peb.scriptMark = function(scriptId, event) {
+  if (window.performance && performance.mark) {
+    performance.mark('peb:' + scriptId + ' ' + event);
+  }
+}
+
+peb.scriptOutputStart = function(scriptId, bytes, outputTime) {
+  var queueDelay = Math.max(0, Date.now() - outputTime);
+  peb.scriptOutputMark = 'peb:' + scriptId + ' output ' + bytes +
+    ' bytes, queued ' + queueDelay + ' ms';
+
+  if (window.performance && performance.mark) {
+    performance.mark(peb.scriptOutputMark);
+  }
+}
+
+peb.scriptOutputEnd = function(scriptId) {
+  if (window.performance && performance.measure) {
+    var measure = 'peb:' + scriptId + ' stdoutFunction';
+    performance.measure(measure, peb.scriptOutputMark);
+    performance.clearMarks(peb.scriptOutputMark);
+    performance.clearMeasures(measure);
+  }
+}
+
+peb.scriptExit = function(scriptId, exitCode) {
+  if (window.performance && performance.measure) {
+    var script = 'peb:' + scriptId;
+    performance.mark(script + ' exit ' + exitCode);
+
+    try {
+      performance.measure(script, script + ' spawn', script + ' exit ' + exitCode);
+    } catch (error) {
+      // The page was loaded after the script was started.
+    }
+
+    performance.clearMarks(script + ' spawn');
+    performance.clearMarks(script + ' first output');
+    performance.clearMarks(script + ' exit ' + exitCode);
+    performance.clearMeasures(script);
+  }
+}
+
+peb.openWindow = function(url) {
+  return window.open(url, '_blank');
+}
+
 peb.checkUserInputBeforeClose = function() {
   var textEntered = false;
   var close = true;
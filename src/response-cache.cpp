@@ -0,0 +1,231 @@
+/*
+ Perl Executing Browser
+
+ This program is free software;
+ you can redistribute it and/or modify it under the terms of the
+ GNU Lesser General Public License,
+ as published by the Free Software Foundation;
+ either version 3 of the License, or (at your option) any later version.
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY;
+ without even the implied warranty of MERCHANTABILITY or
+ FITNESS FOR A PARTICULAR PURPOSE.
+ Dimitar D. Mitov, 2013 - 2019
+ Valcho Nedelchev, 2014 - 2016
+ https://github.com/ddmitov/perl-executing-browser
+*/
+
+#include <QDir>
+#include <QIODevice>
+#include <QNetworkCacheMetaData>
+
+#include "response-cache.h"
+
+// ==============================
+// RESPONSE CACHE CONSTRUCTOR:
+// ==============================
+QResponseCache::QResponseCache(QString cacheDirectory,
+                               int memoryCapacity,
+                               qint64 diskCapacity)
+    : QObject(0)
+{
+    hits = 0;
+    revalidations = 0;
+    misses = 0;
+
+    // The cost of every memory cache entry is the size of its body:
+    memoryCache.setMaxCost(memoryCapacity);
+
+    QDir().mkpath(cacheDirectory);
+
+    diskCache = new QNetworkDiskCache(this);
+    diskCache->setCacheDirectory(cacheDirectory);
+    diskCache->setMaximumCacheSize(diskCapacity);
+}
+
+// ==============================
+// Response headers:
+// ==============================
+bool QResponseCache::qCacheable(
+        QList<QPair<QByteArray, QByteArray> > headers,
+        QCachedResponse &response)
+{
+    bool maxAgeFound = false;
+    bool expiresFound = false;
+    bool noCache = false;
+    qint64 maxAge = 0;
+    QDateTime expires;
+
+    for (int index = 0; index < headers.length(); index++) {
+        QByteArray name = headers[index].first.toLower();
+        QByteArray value = headers[index].second;
+
+        if (name == "cache-control") {
+            foreach (QByteArray directive, value.toLower().split(',')) {
+                directive = directive.trimmed();
+
+                if (directive == "no-store") {
+                    return false;
+                }
+
+                if (directive == "no-cache") {
+                    noCache = true;
+                }
+
+                if (directive.startsWith("max-age=")) {
+                    maxAge = directive.mid(8).toLongLong();
+                    maxAgeFound = true;
+                }
+            }
+        }
+
+        if (name == "expires") {
+            expires = QDateTime::fromString(
+                        QString::fromLatin1(value), Qt::RFC2822Date);
+            expiresFound = expires.isValid();
+        }
+
+        if (name == "etag") {
+            response.entityTag = value;
+        }
+
+        if (name == "last-modified") {
+            response.lastModified = value;
+        }
+
+        // Cache keys are URLs only, so responses varying with
+        // request headers are never stored:
+        if (name == "vary") {
+            return false;
+        }
+    }
+
+    // Max-age takes precedence over Expires.
+    // Responses having only validators are stored as stale and
+    // are revalidated before every use:
+    QDateTime now = QDateTime::currentDateTimeUtc();
+
+    if (maxAgeFound == true) {
+        response.expirationDate = now.addSecs(maxAge);
+    } else if (expiresFound == true) {
+        response.expirationDate = expires;
+    } else {
+        response.expirationDate = now;
+    }
+
+    if (noCache == true) {
+        response.expirationDate = now;
+    }
+
+    if (response.expirationDate <= now and
+            response.entityTag.isEmpty() and
+            response.lastModified.isEmpty()) {
+        return false;
+    }
+
+    return true;
+}
+
+// ==============================
+// Cache lookup:
+// ==============================
+bool QResponseCache::qLookup(QUrl url, QCachedResponse &response)
+{
+    QString key = url.toString();
+
+    if (memoryCache.contains(key)) {
+        response = *memoryCache.object(key);
+        return true;
+    }
+
+    QNetworkCacheMetaData metaData = diskCache->metaData(url);
+
+    if (!metaData.isValid()) {
+        return false;
+    }
+
+    QIODevice *data = diskCache->data(url);
+
+    if (data == NULL) {
+        return false;
+    }
+
+    response.body = data->readAll();
+    delete data;
+
+    response.expirationDate = metaData.expirationDate();
+
+    foreach (QNetworkCacheMetaData::RawHeader header,
+             metaData.rawHeaders()) {
+        if (header.first == "Content-Type") {
+            response.contentType = header.second;
+        }
+
+        if (header.first == "ETag") {
+            response.entityTag = header.second;
+        }
+
+        if (header.first == "Last-Modified") {
+            response.lastModified = header.second;
+        }
+    }
+
+    // Entries read from disk are promoted to the memory cache:
+    memoryCache.insert(key, new QCachedResponse(response),
+                       response.body.size());
+
+    return true;
+}
+
+// ==============================
+// Cache storage:
+// ==============================
+void QResponseCache::qStore(QUrl url, QCachedResponse response)
+{
+    // Responses larger than the memory cache are stored only on disk:
+    memoryCache.insert(url.toString(), new QCachedResponse(response),
+                       response.body.size());
+
+    QNetworkCacheMetaData::RawHeaderList rawHeaders;
+    rawHeaders.append(qMakePair(QByteArray("Content-Type"),
+                                response.contentType));
+
+    if (!response.entityTag.isEmpty()) {
+        rawHeaders.append(qMakePair(QByteArray("ETag"),
+                                    response.entityTag));
+    }
+
+    if (!response.lastModified.isEmpty()) {
+        rawHeaders.append(qMakePair(QByteArray("Last-Modified"),
+                                    response.lastModified));
+    }
+
+    QNetworkCacheMetaData metaData;
+    metaData.setUrl(url);
+    metaData.setExpirationDate(response.expirationDate);
+    metaData.setRawHeaders(rawHeaders);
+    metaData.setSaveToDisk(true);
+
+    QIODevice *data = diskCache->prepare(metaData);
+
+    if (data != NULL) {
+        data->write(response.body);
+        diskCache->insert(data);
+    }
+}
+
+void QResponseCache::qRefresh(QUrl url, QDateTime expirationDate)
+{
+    QString key = url.toString();
+
+    if (memoryCache.contains(key)) {
+        memoryCache.object(key)->expirationDate = expirationDate;
+    }
+
+    QNetworkCacheMetaData metaData = diskCache->metaData(url);
+
+    if (metaData.isValid()) {
+        metaData.setExpirationDate(expirationDate);
+        diskCache->updateMetaData(metaData);
+    }
+}
@@ -0,0 +1,73 @@
+/*
+ Perl Executing Browser
+
+ This program is free software;
+ you can redistribute it and/or modify it under the terms of the
+ GNU Lesser General Public License,
+ as published by the Free Software Foundation;
+ either version 3 of the License, or (at your option) any later version.
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY;
+ without even the implied warranty of MERCHANTABILITY or
+ FITNESS FOR A PARTICULAR PURPOSE.
+ Dimitar D. Mitov, 2013 - 2019
+ Valcho Nedelchev, 2014 - 2016
+ https://github.com/ddmitov/perl-executing-browser
+*/
+
+#ifndef RESPONSE_CACHE_H
+#define RESPONSE_CACHE_H
+
+#include <QByteArray>
+#include <QCache>
+#include <QDateTime>
+#include <QList>
+#include <QNetworkDiskCache>
+#include <QObject>
+#include <QPair>
+#include <QUrl>
+
+// ==============================
+// CACHED RESPONSE DEFINITION:
+// ==============================
+struct QCachedResponse
+{
+    QByteArray contentType;
+    QByteArray body;
+    QByteArray entityTag;
+    QByteArray lastModified;
+    QDateTime expirationDate;
+};
+
+// ==============================
+// RESPONSE CACHE CLASS DEFINITION:
+// Memory LRU cache of GET responses backed by a disk cache
+// ==============================
+class QResponseCache : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit QResponseCache(QString cacheDirectory,
+                            int memoryCapacity,
+                            qint64 diskCapacity);
+
+    // Fills a response from its headers and
+    // returns false if the response must not be stored:
+    static bool qCacheable(QList<QPair<QByteArray, QByteArray> > headers,
+                           QCachedResponse &response);
+
+    bool qLookup(QUrl url, QCachedResponse &response);
+    void qStore(QUrl url, QCachedResponse response);
+    void qRefresh(QUrl url, QDateTime expirationDate);
+
+    qint64 hits;
+    qint64 revalidations;
+    qint64 misses;
+
+private:
+    QCache<QString, QCachedResponse> memoryCache;
+    QNetworkDiskCache *diskCache;
+};
+
+#endif // RESPONSE_CACHE_H
@@ -22,8 +22,8 @@
 // ==============================
 // SCRIPT HANDLER CONSTRUCTOR:
 // ==============================
-QScriptHandler::QScriptHandler(QJsonObject scriptJsonObject)
-    : QObject(0)
+QScriptHandler::QScriptHandler(QJsonObject scriptJsonObject, QObject *parent)
+    : QObject(parent)
 {
     scriptId = scriptJsonObject["id"].toString();
 
@@ -43,9 +43,152 @@ QScriptHandler::QScriptHandler(QJsonObject scriptJsonObject)
                      this,
                      SLOT(qScriptFinishedSlot()));
 
+    QObject::connect(&scriptProcess, SIGNAL(started()),
+                     this, SLOT(qScriptStartedSlot()));
+
+    QObject::connect(&scriptProcess,
+                     SIGNAL(error(QProcess::ProcessError)),
+                     this,
+                     SLOT(qScriptStartErrorSlot(QProcess::ProcessError)));
+
+    // Every script leads its own process group, so that
+    // processes started by the script are stopped together with it:
+    scriptProcess.newProcessGroup = true;
+
+    // Resource limits of the script override
+    // the default limits of the application:
+    QJsonObject limits = QJsonObject::fromVariantMap(
+                qApp->property("scriptLimits").toMap());
+
+    QJsonObject scriptLimits = scriptJsonObject["limits"].toObject();
+    foreach (QString limit, scriptLimits.keys()) {
+        limits[limit] = scriptLimits[limit];
+    }
+
+    scriptProcess.memoryLimit =
+            qint64(limits["memory"].toDouble() * 1024 * 1024);
+    scriptProcess.cpuWeight = limits["cpuWeight"].toInt();
+    scriptProcess.niceLevel = qBound(0, limits["nice"].toInt(), 19);
+
+    if (limits["ioPriority"].toString() == "best-effort") {
+        scriptProcess.ioPriorityClass = 2;
+        scriptProcess.ioPriorityLevel =
+                qBound(0, limits["ioLevel"].toInt(4), 7);
+    }
+
+    if (limits["ioPriority"].toString() == "idle") {
+        scriptProcess.ioPriorityClass = 3;
+    }
+
+    scriptProcess.prepareResourceLimits();
+
+    // Wall-clock and idle timeouts in seconds.
+    // A script is idle when it neither receives input nor
+    // writes on STDOUT or STDERR:
+    timeout = qRound64(scriptJsonObject["timeout"].toDouble() * 1000);
+    idleTimeout = qRound64(scriptJsonObject["idleTimeout"].toDouble() * 1000);
+
+    timeoutId = 0;
+    idleTimeoutId = 0;
+
+    if (timeout > 0) {
+        timeoutId = QTimerWheel::instance()->qSchedule(
+                    this, "qScriptTimeoutSlot", timeout);
+    }
+
+    if (idleTimeout > 0) {
+        idleTimeoutId = QTimerWheel::instance()->qSchedule(
+                    this, "qScriptIdleTimeoutSlot", idleTimeout);
+    }
+
+    // Background policy used while the window is hidden:
+    // "run" - the script runs and its output is delivered,
+    // "latest" - only the latest output is delivered later,
+    // "throttle" - like "latest" and the script is paused
+    // outside of its duty cycle in percent of every second:
+    backgroundPolicy = scriptJsonObject["background"].toString("run");
+    throttleDutyCycle =
+            qBound(1, scriptJsonObject["throttleDutyCycle"].toInt(10), 99);
+
+    background = false;
+    throttleStopped = false;
+    waitingForSlot = false;
+    latestOutputBytes = 0;
+
+    throttleTimer = new QTimer(this);
+    throttleTimer->setSingleShot(true);
+    throttleTimer->setTimerType(Qt::PreciseTimer);
+
+    QObject::connect(throttleTimer, SIGNAL(timeout()),
+                     this, SLOT(qThrottleSlot()));
+
     scriptProcess.setWorkingDirectory(qApp->property("application").toString());
 
+    // The same script can run in several windows at the same time:
+    traceId = scriptId + "@" + QString::number((quintptr) this, 16);
+    outputReceived = false;
+    outputTime = 0;
+    deliveries = 0;
+
+    // Resource use of the script is sampled every second,
+    // because /proc is no longer readable after the script has exited:
+    spawnLatency = 0;
+    wallTime = 0;
+    stdinBytes = 0;
+    stdoutBytes = 0;
+    stderrBytes = 0;
+    finished = false;
+    idle = false;
+    lastCpuTime = 0;
+
+    usageTimer = new QTimer(this);
+
+    QObject::connect(usageTimer, SIGNAL(timeout()),
+                     this, SLOT(qUsageSlot()));
+
+#ifdef Q_OS_LINUX
+    usageTimer->start(1000);
+#endif
+
+    QJsonObject traceArguments;
+    traceArguments["file"] = scriptFullFilePath;
+
+    QTraceRecorder::instance()->qBegin("script", scriptId, traceId,
+                                       traceArguments);
+
+    qint64 spawnSpan = QTraceRecorder::instance()->qNow();
+    runTimer.start();
+
     scriptProcess.start((qApp->property("perlInterpreter").toString()),
                         QStringList() << scriptFullFilePath,
                         QProcess::Unbuffered | QProcess::ReadWrite);
+
+    QTraceRecorder::instance()->qComplete("script", "script spawn",
+                                          spawnSpan, traceArguments);
+
+    probeId = scriptId.toUtf8();
+    PEB_PROBE2(script__spawn, probeId.constData(),
+               (long long) scriptProcess.processId());
+}
+
+// ==============================
+// SCRIPT HANDLER DESTRUCTOR:
+// A handler deleted together with its page kills its script,
+// which is not reported as finished anymore.
+// ==============================
+QScriptHandler::~QScriptHandler()
+{
+    QObject::disconnect(&scriptProcess, 0, this, 0);
+
+    QTimerWheel::instance()->qCancel(timeoutId);
+    QTimerWheel::instance()->qCancel(idleTimeoutId);
+
+    if (scriptProcess.state() != QProcess::NotRunning) {
+        scriptProcess.killProcessGroup();
+        scriptProcess.waitForFinished(1000);
+    }
+
+    scriptProcess.releaseResourceLimits();
+
+    QMetrics::instance()->outputBacklog -= latestOutputBytes;
 }
@@ -19,7 +19,17 @@
 #define SCRIPT_HANDLER_H
 
 #include <QApplication>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QJsonObject>
 #include <QProcess>
+#include <QTimer>
+
+#include "child-process.h"
+#include "metrics.h"
+#include "probes.h"
+#include "timer-wheel.h"
+#include "trace-recorder.h"
 
 // ==============================
 // SCRIPT HANDLER:
@@ -31,32 +41,396 @@ class QScriptHandler : public QObject
 signals:
     void displayScriptOutputSignal(QString scriptId, QString output);
     void displayScriptErrorsSignal(QString errors);
-    void scriptFinishedSignal(QString scriptId);
+    void scriptFinishedSignal(QString scriptId, QJsonObject stats);
+    void scriptIdleSignal(bool idle);
 
 public slots:
     void qScriptOutputSlot()
     {
-        QString scriptOutput = scriptProcess.readAllStandardOutput();
-        emit displayScriptOutputSignal(scriptId, scriptOutput);
+        qResetIdleTimeout();
+
+        QByteArray scriptOutputBytes = scriptProcess.readAllStandardOutput();
+        QString scriptOutput = QString::fromUtf8(scriptOutputBytes);
+        stdoutBytes = stdoutBytes + scriptOutputBytes.size();
+
+        PEB_PROBE2(script__stdout, probeId.constData(),
+                   scriptOutputBytes.size());
+        outputTime = QDateTime::currentMSecsSinceEpoch();
+
+        if (outputReceived == false) {
+            outputReceived = true;
+
+            QJsonObject traceArguments;
+            traceArguments["id"] = scriptId;
+            QTraceRecorder::instance()->qInstant("script", "first output",
+                                                 traceArguments);
+        }
+
+        // Only the latest output is kept while the window is hidden:
+        if (background == true and backgroundPolicy != "run") {
+            QMetrics::instance()->outputBacklog +=
+                    scriptOutputBytes.size() - latestOutputBytes;
+
+            latestOutput = scriptOutput;
+            latestOutputBytes = scriptOutputBytes.size();
+            return;
+        }
+
+        qDeliverOutput(scriptOutput, scriptOutputBytes.size());
     }
 
     void qScriptErrorsSlot()
     {
-        QString scriptErrors = scriptProcess.readAllStandardError();
+        qResetIdleTimeout();
+
+        QByteArray scriptErrorsBytes = scriptProcess.readAllStandardError();
+        QString scriptErrors = QString::fromUtf8(scriptErrorsBytes);
+        stderrBytes = stderrBytes + scriptErrorsBytes.size();
+
+        PEB_PROBE2(script__stderr, probeId.constData(),
+                   scriptErrorsBytes.size());
+
+        // Perl reports failed allocations under
+        // the address space limit used without control groups:
+        if (scriptProcess.memoryLimit > 0 and
+                scriptErrors.contains("Out of memory!")) {
+            scriptErrors.append(
+                        scriptId + ": memory limit of " +
+                        QString::number(scriptProcess.memoryLimit /
+                                        (1024 * 1024)) +
+                        " MB is reached.\n");
+        }
+
         emit displayScriptErrorsSignal(scriptErrors);
     }
 
     void qScriptFinishedSlot()
     {
+        QTimerWheel::instance()->qCancel(timeoutId);
+        QTimerWheel::instance()->qCancel(idleTimeoutId);
+        timeoutId = 0;
+        idleTimeoutId = 0;
+
+        throttleTimer->stop();
+        usageTimer->stop();
+
+        qDeliverLatestOutput();
+
         scriptProcess.close();
-        emit scriptFinishedSignal(scriptId);
+
+        // The control group of the script is still readable here:
+        wallTime = runTimer.elapsed();
+        scriptProcess.sampleResourceUsage();
+        finished = true;
+
+        QString limitsReport = scriptProcess.resourceLimitsReport();
+        if (limitsReport.length() > 0) {
+            emit displayScriptErrorsSignal(scriptId + ": " + limitsReport);
+        }
+
+        scriptProcess.releaseResourceLimits();
+
+        PEB_PROBE2(script__exit, probeId.constData(),
+                   scriptProcess.exitCode());
+
+        QJsonObject traceArguments;
+        traceArguments["exitCode"] = scriptProcess.exitCode();
+        QTraceRecorder::instance()->qEnd("script", scriptId, traceId,
+                                         traceArguments);
+
+        emit scriptFinishedSignal(scriptId, qStats());
+    }
+
+    void qScriptStartErrorSlot(QProcess::ProcessError error)
+    {
+        // A script which could not be started frees its scheduler slot:
+        if (error == QProcess::FailedToStart) {
+            QTraceRecorder::instance()->qEnd("script", scriptId, traceId);
+
+            scriptProcess.releaseResourceLimits();
+
+            usageTimer->stop();
+            wallTime = runTimer.elapsed();
+            finished = true;
+
+            emit scriptFinishedSignal(scriptId, qStats());
+        }
+    }
+
+    // ==============================
+    // Timeouts and cancellation:
+    // The whole process group of the script is killed and
+    // the script is finished as soon as its processes exit.
+    // ==============================
+    void qScriptTimeoutSlot()
+    {
+        timeoutId = 0;
+
+        emit displayScriptErrorsSignal(
+                    scriptId + ": timeout of " +
+                    QString::number(timeout / 1000.0) +
+                    " seconds is reached and the script is stopped.\n");
+
+        scriptProcess.killProcessGroup();
+    }
+
+    void qScriptIdleTimeoutSlot()
+    {
+        idleTimeoutId = 0;
+
+        emit displayScriptErrorsSignal(
+                    scriptId + ": idle timeout of " +
+                    QString::number(idleTimeout / 1000.0) +
+                    " seconds is reached and the script is stopped.\n");
+
+        scriptProcess.killProcessGroup();
+    }
+
+    void qCancelSlot()
+    {
+        scriptProcess.killProcessGroup();
+    }
+
+    // ==============================
+    // Resource accounting:
+    // ==============================
+    void qScriptStartedSlot()
+    {
+        spawnLatency = runTimer.nsecsElapsed() / 1000000.0;
+    }
+
+    void qUsageSlot()
+    {
+        scriptProcess.sampleResourceUsage();
+
+        // A script using less than a tenth of a core, like
+        // an interactive script waiting for input, is idle and
+        // does not count against the global limit of running scripts:
+        qint64 cpuTime =
+                scriptProcess.userCpuTime + scriptProcess.systemCpuTime;
+        bool cpuIdle = (cpuTime - lastCpuTime < 100);
+        lastCpuTime = cpuTime;
+
+        // A script paused by the script scheduler stays idle:
+        if (waitingForSlot == false and cpuIdle != idle) {
+            idle = cpuIdle;
+            emit scriptIdleSignal(idle);
+        }
+    }
+
+    // ==============================
+    // Background policy:
+    // ==============================
+    void qThrottleSlot()
+    {
+        // The script runs only during its duty cycle of every second:
+        int runningTime = 10 * throttleDutyCycle;
+
+        if (throttleStopped == false) {
+            throttleStopped = scriptProcess.stopProcessGroup();
+
+            if (throttleStopped == true) {
+                throttleTimer->start(1000 - runningTime);
+            }
+        } else {
+            if (waitingForSlot == false) {
+                scriptProcess.continueProcessGroup();
+            }
+
+            throttleStopped = false;
+            throttleTimer->start(runningTime);
+        }
+    }
+
+    // ==============================
+    // Global script limit:
+    // A script which is busy again is paused by the script scheduler
+    // until a slot is free and is idle meanwhile.
+    // ==============================
+    bool qPauseForSlot()
+    {
+        if (finished == true) {
+            return false;
+        }
+
+        if (throttleStopped == false and
+                scriptProcess.stopProcessGroup() == false) {
+            return false;
+        }
+
+        waitingForSlot = true;
+        idle = true;
+        return true;
+    }
+
+    bool qResumeWithSlot()
+    {
+        if (finished == true or waitingForSlot == false) {
+            return false;
+        }
+
+        waitingForSlot = false;
+        idle = false;
+
+        if (throttleStopped == false) {
+            scriptProcess.continueProcessGroup();
+        }
+
+        // CPU time is measured again from the resumption:
+        scriptProcess.sampleResourceUsage();
+        lastCpuTime =
+                scriptProcess.userCpuTime + scriptProcess.systemCpuTime;
+        return true;
     }
 
 public:
-    QScriptHandler(QJsonObject);
-    QProcess scriptProcess;
+    QScriptHandler(QJsonObject scriptJsonObject, QObject *parent = 0);
+    ~QScriptHandler();
+
+    void qSetBackground(bool windowInBackground)
+    {
+        background = windowInBackground;
+
+        if (backgroundPolicy == "throttle" and background == true) {
+            throttleStopped = false;
+            throttleTimer->start(10 * throttleDutyCycle);
+        }
+
+        if (background == false) {
+            throttleTimer->stop();
+
+            if (throttleStopped == true) {
+                if (waitingForSlot == false) {
+                    scriptProcess.continueProcessGroup();
+                }
+
+                throttleStopped = false;
+            }
+
+            qDeliverLatestOutput();
+        }
+    }
+
+    void qDeliverOutput(QString output, qint64 outputBytes)
+    {
+        deliveries++;
+
+        QMetrics::instance()->deliveries++;
+        QMetrics::instance()->deliveredBytes += outputBytes;
+
+        emit displayScriptOutputSignal(scriptId, output);
+    }
+
+    void qDeliverLatestOutput()
+    {
+        if (!latestOutput.isNull()) {
+            QString output = latestOutput;
+            qint64 outputBytes = latestOutputBytes;
+
+            latestOutput = QString();
+            latestOutputBytes = 0;
+
+            QMetrics::instance()->outputBacklog -= outputBytes;
+            qDeliverOutput(output, outputBytes);
+        }
+    }
+
+    void qWriteInput(QByteArray input)
+    {
+        qResetIdleTimeout();
+
+        if (scriptProcess.isOpen()) {
+            qint64 written = scriptProcess.write(input);
+
+            if (written > 0) {
+                stdinBytes = stdinBytes + written;
+            }
+        }
+    }
+
+    QJsonObject qStats()
+    {
+        if (finished == false) {
+            wallTime = runTimer.elapsed();
+        }
+
+        QJsonObject stats;
+        stats["id"] = scriptId;
+        stats["state"] = finished ? "finished" : "running";
+        stats["spawnLatency"] = spawnLatency;
+        stats["wallTime"] = wallTime;
+        stats["userCpuTime"] = scriptProcess.userCpuTime;
+        stats["systemCpuTime"] = scriptProcess.systemCpuTime;
+        stats["peakMemory"] = scriptProcess.peakMemory;
+        stats["stdinBytes"] = stdinBytes;
+        stats["stdoutBytes"] = stdoutBytes;
+        stats["stderrBytes"] = stderrBytes;
+        stats["deliveries"] = deliveries;
+
+        if (finished == true) {
+            stats["exitCode"] = scriptProcess.exitCode();
+        }
+
+        return stats;
+    }
+
+    void qResetIdleTimeout()
+    {
+        if (idleTimeoutId != 0) {
+            idleTimeoutId = QTimerWheel::instance()->qReschedule(
+                        idleTimeoutId, this,
+                        "qScriptIdleTimeoutSlot", idleTimeout);
+        }
+    }
+
+    QChildProcess scriptProcess;
     QString scriptId;
     QString scriptFullFilePath;
+
+    // Timeouts in milliseconds, 0 if not set:
+    qint64 timeout;
+    qint64 idleTimeout;
+
+    // "run", "latest" or "throttle":
+    QString backgroundPolicy;
+    int throttleDutyCycle;
+
+    // Time of the latest output in milliseconds since the epoch and
+    // the number of output batches delivered to the page:
+    qint64 outputTime;
+    int deliveries;
+
+    // True if the script used almost no CPU in the latest second:
+    bool idle;
+
+private:
+    quint64 timeoutId;
+    quint64 idleTimeoutId;
+
+    QString traceId;
+    QByteArray probeId;
+    bool outputReceived;
+
+    bool background;
+    QString latestOutput;
+    qint64 latestOutputBytes;
+    QTimer *throttleTimer;
+    bool throttleStopped;
+
+    // True while the script is paused by the script scheduler:
+    bool waitingForSlot;
+
+    // Spawn latency and wall time in milliseconds and
+    // bytes written to or read from the pipes of the script:
+    QElapsedTimer runTimer;
+    QTimer *usageTimer;
+    double spawnLatency;
+    qint64 wallTime;
+    qint64 stdinBytes;
+    qint64 stdoutBytes;
+    qint64 stderrBytes;
+    bool finished;
+    qint64 lastCpuTime;
 };
 
 #endif // SCRIPT_HANDLER_H
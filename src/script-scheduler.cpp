@@ -0,0 +1,391 @@
+/*
+ Perl Executing Browser
+
+ This program is free software;
+ you can redistribute it and/or modify it under the terms of the
+ GNU Lesser General Public License,
+ as published by the Free Software Foundation;
+ either version 3 of the License, or (at your option) any later version.
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY;
+ without even the implied warranty of MERCHANTABILITY or
+ FITNESS FOR A PARTICULAR PURPOSE.
+ Dimitar D. Mitov, 2013 - 2019
+ Valcho Nedelchev, 2014 - 2016
+ https://github.com/ddmitov/perl-executing-browser
+*/
+
+#include <QJsonArray>
+#include <QMetaObject>
+#include <QThread>
+
+#include "script-scheduler.h"
+
+// ==============================
+// SCRIPT SCHEDULER CONSTRUCTOR:
+// ==============================
+QScriptScheduler::QScriptScheduler()
+    : QObject(0)
+{
+    // One script is started for every processor core by default:
+    maximumScripts = qMax(QThread::idealThreadCount(), 1);
+
+    runningScripts = 0;
+    idleScripts = 0;
+    startedScripts = 0;
+    totalWait = 0;
+    lastWait = 0;
+
+    queueChangePending = false;
+
+    schedulerClock.start();
+}
+
+QScriptScheduler *QScriptScheduler::instance()
+{
+    static QScriptScheduler *scriptScheduler = new QScriptScheduler();
+    return scriptScheduler;
+}
+
+// ==============================
+// Queues:
+// ==============================
+void QScriptScheduler::qEnqueue(QObject *page, QJsonObject scriptJsonObject)
+{
+    QQueuedScript queuedScript;
+    queuedScript.page = page;
+    queuedScript.scriptJsonObject = scriptJsonObject;
+    queuedScript.enqueueTime = schedulerClock.elapsed();
+
+    if (scriptJsonObject["priority"].toString() == "batch") {
+        batchQueue.append(queuedScript);
+    } else {
+        interactiveQueue.append(queuedScript);
+    }
+
+    qDispatch();
+}
+
+bool QScriptScheduler::qAppendInput(QObject *page,
+                                    QString scriptId,
+                                    QString input)
+{
+    // Input for a script waiting in a queue is
+    // written on its STDIN after it is started:
+    QList<QQueuedScript> *queues[] = {&interactiveQueue, &batchQueue};
+
+    for (int queueIndex = 0; queueIndex < 2; queueIndex++) {
+        QList<QQueuedScript> &queue = *queues[queueIndex];
+
+        for (int index = 0; index < queue.length(); index++) {
+            if (queue[index].page == page and
+                    queue[index].scriptJsonObject["id"].toString() ==
+                    scriptId) {
+                if (input.length() > 0) {
+                    QString scriptInput =
+                            queue[index].scriptJsonObject["scriptInput"]
+                            .toString();
+
+                    if (scriptInput.length() > 0) {
+                        scriptInput.append("\n");
+                    }
+
+                    queue[index].scriptJsonObject["scriptInput"] =
+                            scriptInput + input;
+                }
+
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+bool QScriptScheduler::qCancel(QObject *page, QString scriptId)
+{
+    QList<QQueuedScript> *queues[] = {&interactiveQueue, &batchQueue};
+
+    for (int queueIndex = 0; queueIndex < 2; queueIndex++) {
+        QList<QQueuedScript> &queue = *queues[queueIndex];
+
+        for (int index = 0; index < queue.length(); index++) {
+            if (queue[index].page == page and
+                    queue[index].scriptJsonObject["id"].toString() ==
+                    scriptId) {
+                queue.removeAt(index);
+                qQueueChanged();
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+void QScriptScheduler::qScriptFinished(QObject *page, bool idle)
+{
+    QPageScripts &pageScripts = qPageScripts(page);
+
+    if (pageScripts.running > 0) {
+        pageScripts.running--;
+
+        if (idle == true and pageScripts.idle > 0) {
+            pageScripts.idle--;
+            idleScripts--;
+        } else {
+            runningScripts--;
+        }
+    }
+
+    qDispatch();
+}
+
+void QScriptScheduler::qScriptIdle(QObject *page, QObject *script, bool idle)
+{
+    // An idle script frees its slot and takes it back when it is busy
+    // only if a slot is free. Otherwise it is paused and
+    // stays idle until a slot is freed:
+    QPageScripts &pageScripts = qPageScripts(page);
+
+    if (idle == true and pageScripts.idle < pageScripts.running) {
+        pageScripts.idle++;
+        idleScripts++;
+        runningScripts--;
+    }
+
+    if (idle == false and pageScripts.idle > 0) {
+        bool paused = false;
+
+        if (runningScripts >= maximumScripts) {
+            QMetaObject::invokeMethod(script, "qPauseForSlot",
+                                      Q_RETURN_ARG(bool, paused));
+        }
+
+        // Scripts can not be paused on Windows and
+        // take their slots back even if the limit is reached:
+        if (paused == true) {
+            QWaitingScript waitingScript;
+            waitingScript.page = page;
+            waitingScript.script = script;
+            waitingScripts.append(waitingScript);
+        } else {
+            pageScripts.idle--;
+            idleScripts--;
+            runningScripts++;
+        }
+    }
+
+    qDispatch();
+}
+
+void QScriptScheduler::qRemovePage(QObject *page)
+{
+    // Scripts of a closing page are not started anymore:
+    QList<QQueuedScript> *queues[] = {&interactiveQueue, &batchQueue};
+
+    for (int queueIndex = 0; queueIndex < 2; queueIndex++) {
+        QList<QQueuedScript> &queue = *queues[queueIndex];
+
+        for (int index = queue.length() - 1; index >= 0; index--) {
+            if (queue[index].page == page or queue[index].page.isNull()) {
+                queue.removeAt(index);
+            }
+        }
+    }
+
+    qQueueChanged();
+}
+
+void QScriptScheduler::qReleasePage(QObject *page)
+{
+    // Scripts of a deleted page are killed together with the page and
+    // never report that they are finished:
+    if (pages.contains(page)) {
+        runningScripts = runningScripts -
+                (pages.value(page).running - pages.value(page).idle);
+        idleScripts = idleScripts - pages.value(page).idle;
+        pages.remove(page);
+    }
+
+    qRemovePage(page);
+    qDispatch();
+}
+
+void QScriptScheduler::qSetPageLimit(QObject *page, int limit)
+{
+    qPageScripts(page).limit = limit;
+    qDispatch();
+}
+
+QPageScripts &QScriptScheduler::qPageScripts(QObject *page)
+{
+    // An entry left by a deleted page is reset and its slots are freed:
+    QPageScripts &pageScripts = pages[page];
+
+    if (pageScripts.page.isNull()) {
+        runningScripts =
+                runningScripts - (pageScripts.running - pageScripts.idle);
+        idleScripts = idleScripts - pageScripts.idle;
+
+        pageScripts.page = page;
+        pageScripts.running = 0;
+        pageScripts.idle = 0;
+        pageScripts.limit = 0;
+    }
+
+    return pageScripts;
+}
+
+// ==============================
+// Dispatching:
+// ==============================
+void QScriptScheduler::qDispatch()
+{
+    // Interactive scripts are started first.
+    // Batch scripts may not take the last free slot,
+    // so that an interactive script can always start immediately:
+    int batchLimit = qMax(maximumScripts - 1, 1);
+
+    qResumeWaiting();
+
+    while (qStartFirst(interactiveQueue, maximumScripts) or
+           qStartFirst(batchQueue, batchLimit)) {
+    }
+
+    qQueueChanged();
+}
+
+void QScriptScheduler::qResumeWaiting()
+{
+    // Paused scripts take free slots before new scripts are started.
+    // Finished scripts and scripts of deleted pages are not resumed:
+    while (runningScripts < maximumScripts and !waitingScripts.isEmpty()) {
+        QWaitingScript waitingScript = waitingScripts.takeFirst();
+
+        if (waitingScript.page.isNull() or waitingScript.script.isNull()) {
+            continue;
+        }
+
+        bool resumed = false;
+        QMetaObject::invokeMethod(waitingScript.script, "qResumeWithSlot",
+                                  Q_RETURN_ARG(bool, resumed));
+
+        QPageScripts &pageScripts = qPageScripts(waitingScript.page);
+
+        if (resumed == true and pageScripts.idle > 0) {
+            pageScripts.idle--;
+            idleScripts--;
+            runningScripts++;
+        }
+    }
+}
+
+bool QScriptScheduler::qStartFirst(QList<QQueuedScript> &queue, int limit)
+{
+    if (runningScripts >= limit) {
+        return false;
+    }
+
+    // The oldest script of a page below its own limit is started:
+    for (int index = 0; index < queue.length(); index++) {
+        QObject *page = queue[index].page;
+
+        if (page == NULL) {
+            queue.removeAt(index);
+            index--;
+            continue;
+        }
+
+        QPageScripts &pageScripts = qPageScripts(page);
+
+        int pageLimit =
+                pageScripts.limit > 0 ? pageScripts.limit : maximumScripts;
+
+        if (pageScripts.running >= pageLimit) {
+            continue;
+        }
+
+        QQueuedScript queuedScript = queue.takeAt(index);
+
+        lastWait = schedulerClock.elapsed() - queuedScript.enqueueTime;
+        totalWait = totalWait + lastWait;
+        startedScripts++;
+
+        pageScripts.running++;
+        runningScripts++;
+
+        queuedScript.scriptJsonObject["queueWait"] = double(lastWait);
+
+        QMetaObject::invokeMethod(
+                    page, "qStartQueuedScript",
+                    Q_ARG(QJsonObject, queuedScript.scriptJsonObject));
+
+        return true;
+    }
+
+    return false;
+}
+
+// ==============================
+// Notifications:
+// Many changes of the queues during one turn of the event loop,
+// like all scripts of a closing page, are reported to the pages once:
+// ==============================
+void QScriptScheduler::qQueueChanged()
+{
+    if (queueChangePending == false) {
+        queueChangePending = true;
+        QMetaObject::invokeMethod(this, "qQueueChangedSlot",
+                                  Qt::QueuedConnection);
+    }
+}
+
+void QScriptScheduler::qQueueChangedSlot()
+{
+    queueChangePending = false;
+    emit queueChangedSignal();
+}
+
+// ==============================
+// Status:
+// ==============================
+QJsonObject QScriptScheduler::qStatus(QObject *page)
+{
+    QJsonArray queuedScripts;
+    int queued = 0;
+
+    QList<QQueuedScript> *queues[] = {&interactiveQueue, &batchQueue};
+
+    for (int queueIndex = 0; queueIndex < 2; queueIndex++) {
+        foreach (QQueuedScript queuedScript, *queues[queueIndex]) {
+            queued++;
+
+            if (queuedScript.page == page) {
+                queuedScripts.append(
+                            queuedScript.scriptJsonObject["id"].toString());
+            }
+        }
+    }
+
+    QPageScripts pageScripts = pages.value(page);
+
+    if (pageScripts.page.isNull()) {
+        pageScripts = QPageScripts();
+    }
+
+    QJsonObject status;
+    status["running"] = runningScripts;
+    status["idle"] = idleScripts;
+    status["queued"] = queued;
+    status["maximum"] = maximumScripts;
+    status["pageRunning"] = pageScripts.running;
+    status["pageQueued"] = queuedScripts;
+    status["pageMaximum"] =
+            pageScripts.limit > 0 ? pageScripts.limit : maximumScripts;
+    status["lastWait"] = double(lastWait);
+    status["averageWait"] =
+            double(totalWait / qMax(startedScripts, qint64(1)));
+
+    return status;
+}
@@ -0,0 +1,132 @@
+/*
+ Perl Executing Browser
+
+ This program is free software;
+ you can redistribute it and/or modify it under the terms of the
+ GNU Lesser General Public License,
+ as published by the Free Software Foundation;
+ either version 3 of the License, or (at your option) any later version.
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY;
+ without even the implied warranty of MERCHANTABILITY or
+ FITNESS FOR A PARTICULAR PURPOSE.
+ Dimitar D. Mitov, 2013 - 2019
+ Valcho Nedelchev, 2014 - 2016
+ https://github.com/ddmitov/perl-executing-browser
+*/
+
+#ifndef SCRIPT_SCHEDULER_H
+#define SCRIPT_SCHEDULER_H
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QJsonObject>
+#include <QList>
+#include <QObject>
+#include <QPointer>
+
+// ==============================
+// QUEUED SCRIPT DEFINITION:
+// ==============================
+struct QQueuedScript
+{
+    QPointer<QObject> page;
+    QJsonObject scriptJsonObject;
+    qint64 enqueueTime;
+};
+
+// ==============================
+// PAGE SCRIPTS DEFINITION:
+// Running scripts and the limit of a page.
+// An entry of a deleted page is detected by its guarded pointer,
+// even if a new page is created at the same address.
+// ==============================
+struct QPageScripts
+{
+    QPageScripts() : running(0), idle(0), limit(0) {}
+
+    QPointer<QObject> page;
+    int running;
+
+    // Idle scripts of the page do not count against the global limit:
+    int idle;
+
+    // 0 if the page uses the global limit:
+    int limit;
+};
+
+// ==============================
+// WAITING SCRIPT DEFINITION:
+// A script paused until it can take a slot back.
+// ==============================
+struct QWaitingScript
+{
+    QPointer<QObject> page;
+    QPointer<QObject> script;
+};
+
+// ==============================
+// SCRIPT SCHEDULER CLASS DEFINITION:
+// Concurrency-limited queues of Perl scripts shared by all pages
+// ==============================
+class QScriptScheduler : public QObject
+{
+    Q_OBJECT
+
+signals:
+    // Emitted at most once per turn of the event loop:
+    void queueChangedSignal();
+
+public slots:
+    void qQueueChangedSlot();
+
+public:
+    static QScriptScheduler *instance();
+
+    // Every page has a qStartQueuedScript(QJsonObject) slot
+    // called when one of its scripts may be started:
+    void qEnqueue(QObject *page, QJsonObject scriptJsonObject);
+    bool qAppendInput(QObject *page, QString scriptId, QString input);
+    bool qCancel(QObject *page, QString scriptId);
+    void qScriptFinished(QObject *page, bool idle = false);
+
+    // Every script has qPauseForSlot() and qResumeWithSlot() slots
+    // returning true if the script is paused or resumed:
+    void qScriptIdle(QObject *page, QObject *script, bool idle);
+    void qRemovePage(QObject *page);
+
+    // Frees the slots of a page deleted with running scripts:
+    void qReleasePage(QObject *page);
+
+    void qSetPageLimit(QObject *page, int limit);
+    QJsonObject qStatus(QObject *page);
+
+    int maximumScripts;
+
+private:
+    QScriptScheduler();
+
+    void qDispatch();
+    void qResumeWaiting();
+    bool qStartFirst(QList<QQueuedScript> &queue, int limit);
+    QPageScripts &qPageScripts(QObject *page);
+    void qQueueChanged();
+
+    QList<QQueuedScript> interactiveQueue;
+    QList<QQueuedScript> batchQueue;
+
+    QHash<QObject*, QPageScripts> pages;
+    QList<QWaitingScript> waitingScripts;
+    // Running scripts which are not idle:
+    int runningScripts;
+    int idleScripts;
+
+    QElapsedTimer schedulerClock;
+    qint64 startedScripts;
+    qint64 totalWait;
+    qint64 lastWait;
+
+    bool queueChangePending;
+};
+
+#endif // SCRIPT_SCHEDULER_H
@@ -21,11 +21,21 @@
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QProcess>
+#include <QThread>
 
+#include <climits>
+#include <cstdio>
+
+#include "child-process.h"
 #include "file-reader.h"
+#include "load-balancer.h"
 #include "port-scanner.h"
 #include "server-starter.h"
 
+#ifdef PEB_FASTCGI_MODE
+#include <QWebEngineProfile>
+#endif
+
 // ==============================
 // SERVER STARTER CONSTRUCTOR:
 // ==============================
@@ -33,9 +43,28 @@ QServerStarter::QServerStarter(QString localServerSettingsFilePath)
     : QObject(0)
 {
     bool localServerSettingsCorrect = false;
+    socketActivation = false;
+    fastCgiMode = false;
+#ifdef PEB_FASTCGI_MODE
+    fastCgiHandler = NULL;
+#endif
+    localServerSocket = NULL;
+    loadBalancer = NULL;
+    localServerTester = NULL;
+    localServerPingInterval = 5;
+    localServerMaximumInterval = 250;
+    localServerLoaded = false;
+    localServerStopping = false;
+    localServerStopPhase = 0;
+
     QString localServerFullPath;
     QString port;
-    QStringList localServerCommandLine;
+    QStringList localServerArguments;
+    int instances = 1;
+    int minimumWorkers = 1;
+    int maximumWorkers = 1;
+    int workerIdleTimeout = 60000;
+    bool responseCache = true;
 
     QFileReader *localServerSettingsReader =
             new QFileReader(localServerSettingsFilePath);
@@ -64,23 +93,33 @@ QServerStarter::QServerStarter(QString localServerSettingsFilePath)
 
         if (localServerFile.exists()) {
             localServerFullPath = localServerFullPathSetting;
-            localServerCommandLine.append(localServerFullPath);
+            localServerArguments.append(localServerFullPath);
         } else {
             displayErrorSignal(QString("Local server file is not found."));
         }
 
-        // Local server port:
-        QJsonArray ports = localServerJson["ports"].toArray();
-
-        qint16 firstPort = ports[0].toInt();
-        qint16 lastPort = ports[1].toInt();
-
-        if (firstPort == 0) {
+        // Local server mode.
+        // In FastCGI mode no port is used and requests are sent to
+        // a pool of FastCGI workers on Unix domain sockets:
+        if (localServerJson["mode"].toString() == "fastcgi") {
+#ifdef PEB_FASTCGI_MODE
+            fastCgiMode = true;
+#else
             localServerSettingsCorrect = false;
-            displayErrorSignal(QString("No local server port is set."));
+            displayErrorSignal(
+                        QString("FastCGI mode is not supported on ") +
+                        QString("this platform or browser build."));
+#endif
         }
 
-        if (firstPort > 0) {
+        // Local server port.
+        // An ephemeral port is used if no ports are set:
+        if (fastCgiMode == false) {
+            QJsonArray ports = localServerJson["ports"].toArray();
+
+            quint16 firstPort = ports[0].toInt();
+            quint16 lastPort = ports[1].toInt();
+
             if (lastPort == 0) {
                 lastPort = firstPort;
             }
@@ -90,25 +129,110 @@ QServerStarter::QServerStarter(QString localServerSettingsFilePath)
             if (portScanner->portScannerError.length() == 0) {
                 port = QString::number(portScanner->port);
                 qApp->setProperty("port", port);
+
+                localServerSocket = portScanner->listeningSocket;
             }
 
             if (portScanner->portScannerError.length() > 0) {
+                localServerSettingsCorrect = false;
                 displayErrorSignal(portScanner->portScannerError);
             }
         }
 
+        // Socket activation:
+#ifndef Q_OS_WIN
+        socketActivation = localServerJson["socket-activation"].toBool(false);
+#endif
+
+        // Local server instances.
+        // "auto" starts one instance for every processor core:
+        if (localServerJson["instances"].toString() == "auto") {
+            instances = QThread::idealThreadCount();
+        } else {
+            instances = localServerJson["instances"].toInt(1);
+        }
+
+        if (instances < 1) {
+            instances = 1;
+        }
+
+        // FastCGI workers.
+        // The pool is kept between the minimal and
+        // the maximal number of workers and
+        // idle workers above the minimum are stopped after
+        // the idle timeout in seconds:
+        if (fastCgiMode == true) {
+            QJsonArray workers = localServerJson["workers"].toArray();
+
+            minimumWorkers = workers[0].toInt(1);
+            maximumWorkers = workers[1].toInt(QThread::idealThreadCount());
+
+            if (minimumWorkers < 0) {
+                minimumWorkers = 0;
+            }
+
+            if (maximumWorkers < qMax(minimumWorkers, 1)) {
+                maximumWorkers = qMax(minimumWorkers, 1);
+            }
+
+            workerIdleTimeout =
+                    qRound(localServerJson["idle-timeout"].toDouble(60) *
+                           1000);
+
+            responseCache = localServerJson["response-cache"].toBool(true);
+        }
+
         // Local server command line arguments.
-        // Local server port must be defined at this point!
+        // The #PORT# keyword is substituted separately for every instance:
         QJsonArray commandLineArgumentsArray =
                 localServerJson["command-line-arguments"].toArray();
         foreach (QVariant argument, commandLineArgumentsArray) {
-            QString argumentString = argument.toString();
-            argumentString.replace("#PORT#", port);
-            localServerCommandLine.append(argumentString);
+            localServerArguments.append(argument.toString());
+        }
+
+        // Local server startup timeout in seconds:
+        localServerTimeout =
+                qRound(localServerJson["timeout"].toDouble(5) * 1000);
+
+        if (localServerTimeout <= 0) {
+            localServerSettingsCorrect = false;
+            displayErrorSignal(QString("Local server timeout is invalid."));
+        }
+
+        // Local server restarts after quick failures:
+        localServerMaximumRestarts =
+                localServerJson["maximum-restarts"].toInt(5);
+
+        // Local server log file.
+        // Local server output is written on the STDERR of the browser
+        // if no log file is set:
+        QString logFileName = localServerJson["log-file"].toString();
+
+        if (logFileName.length() > 0) {
+            localServerLog.setFileName(
+                        QString::fromLatin1(qgetenv("PEB_DATA_DIR")) +
+                        "/" + logFileName);
+            localServerLog.open(QIODevice::WriteOnly |
+                                QIODevice::Append |
+                                QIODevice::Text);
+        } else {
+            localServerLog.open(stderr, QIODevice::WriteOnly);
+        }
+
+        // Request statistics are collected only when enabled and
+        // a statistics file written on exit enables them too:
+        qApp->setProperty("requestStatistics",
+                          localServerJson["statistics"].toBool(false));
+
+        if (localServerJson["statistics-file"].toString().length() > 0) {
+            qApp->setProperty("requestStatistics", true);
+            qApp->setProperty(
+                        "requestStatisticsFile",
+                        localServerJson["statistics-file"].toString());
         }
 
         // Local server shutdown command:
-        if (localServerJson["shutdown_command"].toString().length() > 0) {;
+        if (localServerJson["shutdown_command"].toString().length() > 0) {
             qApp->setProperty(
                         "shutdown_command",
                         localServerJson["shutdown_command"].toString());
@@ -121,23 +245,164 @@ QServerStarter::QServerStarter(QString localServerSettingsFilePath)
                     "is empty or malformed.");
     }
 
-    // Local server has to be started as
-    // a detached process for its proper operation:
-    if (localServerSettingsCorrect == true) {
-        QProcess localServer;
-        localServer.startDetached (
-                    qApp->property("perlInterpreter").toString(),
-                    localServerCommandLine);
-
-        // Local server is pinged every second until ready,
-        // but after 5 seconds of being unaivailable,
-        // a timeout message is displayed.
-        // If local server is up and running for less than 5 seconds,
-        // its index page is loaded.
-        localServerTester = new QTimer();
-
-        QObject::connect(localServerTester, SIGNAL (timeout()),
+    // Local server instances are started as supervised child processes of
+    // the browser and are restarted with a backoff after unexpected exits.
+    //
+    // With socket activation all instances inherit the listening socket,
+    // which stays open during restarts. They can be reached before
+    // they have finished their own initialization and the operating system
+    // hands every new connection to an idle instance.
+    //
+    // Without socket activation, a single instance binds the port found by
+    // the port scanner after it is released. Several instances listen on
+    // separate ephemeral ports and the load balancer accepts connections
+    // on the port found by the port scanner.
+#ifdef PEB_FASTCGI_MODE
+    // In FastCGI mode the local server is a pool of workers
+    // started and stopped by the URL scheme handler on demand.
+    // Every request is sent on a separate connection and
+    // the scheme handler replies directly to the browser engine:
+    if (localServerSettingsCorrect == true and fastCgiMode == true) {
+        fastCgiHandler = new QFastCgiHandler(localServerArguments,
+                                             minimumWorkers,
+                                             maximumWorkers,
+                                             workerIdleTimeout,
+                                             &localServerLog);
+
+        // Cacheable responses are kept in a memory cache of 32 MB
+        // backed by a disk cache in the data directory.
+        // Both caches are limited by the runtime profile:
+        if (responseCache == true) {
+            qint64 memoryCacheSize =
+                    qApp->property("memoryCacheSize").toLongLong();
+            if (memoryCacheSize <= 0) {
+                memoryCacheSize = 32;
+            }
+
+            // The capacity of the memory cache is an int number of bytes:
+            fastCgiHandler->responseCache = new QResponseCache(
+                        QString::fromLatin1(qgetenv("PEB_DATA_DIR")) +
+                        "/cache/local-server",
+                        int(qMin(memoryCacheSize * 1024 * 1024,
+                                 qint64(INT_MAX))),
+                        qApp->property("httpCacheSize").toLongLong() *
+                        1024 * 1024);
+        }
+
+        QWebEngineProfile::defaultProfile()->installUrlSchemeHandler(
+                    "local-server", fastCgiHandler);
+
+        localServerLoaded = true;
+
+        QString localServerBaseUrl = "local-server://app/";
+        qApp->setProperty("local_server_base_url", localServerBaseUrl);
+
+        // The start page is loaded after
+        // all signals of the server starter are connected:
+        QTimer::singleShot(0, this, [this, localServerBaseUrl]() {
+            loadUrlSignal(QUrl(localServerBaseUrl));
+        });
+    }
+#endif
+
+    if (localServerSettingsCorrect == true and fastCgiMode == false) {
+        for (int index = 0; index < instances; index++) {
+            QChildProcess *instance = new QChildProcess(this);
+            instance->setProcessChannelMode(QProcess::MergedChannels);
+            instance->newProcessGroup = true;
+
+            QString instancePort = port;
+
+            if (socketActivation == true) {
+                instance->inheritedSocket =
+                        localServerSocket->socketDescriptor();
+
+                // No environment variable can be set safely
+                // between fork() and exec(), so LISTEN_FDS is set here:
+                QProcessEnvironment instanceEnvironment =
+                        QProcessEnvironment::systemEnvironment();
+                instanceEnvironment.insert("LISTEN_FDS", "1");
+                instance->setProcessEnvironment(instanceEnvironment);
+            }
+
+            // The ephemeral port of every instance stays reserved
+            // until the instance is started:
+            if (socketActivation == false and instances > 1) {
+                QPortScanner *instancePortScanner = new QPortScanner(0, 0);
+                instancePortScanner->setParent(instance);
+                instancePort = QString::number(instancePortScanner->port);
+                portReservations.insert(
+                            instance, instancePortScanner->listeningSocket);
+            }
+
+            QStringList instanceArguments;
+            foreach (QString argument, localServerArguments) {
+                instanceArguments.append(
+                            argument.replace("#PORT#", instancePort));
+            }
+
+            if (socketActivation == true) {
+                // LISTEN_PID must hold the process ID of the server and
+                // only a shell replaced by the server through exec knows it:
+                instanceArguments.prepend(
+                            qApp->property("perlInterpreter").toString());
+                instanceArguments.prepend("sh");
+                instanceArguments.prepend(
+                            "LISTEN_PID=$$; export LISTEN_PID; exec \"$@\"");
+                instanceArguments.prepend("-c");
+
+                instance->setProgram("/bin/sh");
+            } else {
+                instance->setProgram(
+                            qApp->property("perlInterpreter").toString());
+            }
+
+            instance->setArguments(instanceArguments);
+
+            instance->setProperty("instance", index + 1);
+            instance->setProperty("port", instancePort.toInt());
+            instance->setProperty("ready", false);
+            instance->setProperty("downSince", -1);
+            instance->setProperty("restartDelay", 100);
+            instance->setProperty("quickFailures", 0);
+
+            QObject::connect(instance, SIGNAL(readyReadStandardOutput()),
+                             this, SLOT(qLocalServerOutputSlot()));
+
+            QObject::connect(instance,
+                             SIGNAL(finished(int, QProcess::ExitStatus)),
+                             this,
+                             SLOT(qLocalServerFinishedSlot(
+                                      int, QProcess::ExitStatus)));
+
+            QObject::connect(instance,
+                             SIGNAL(error(QProcess::ProcessError)),
+                             this,
+                             SLOT(qLocalServerErrorSlot(
+                                      QProcess::ProcessError)));
+
+            localServers.append(instance);
+        }
+
+        if (socketActivation == false and instances > 1) {
+            loadBalancer = new QLoadBalancer(localServerSocket, localServers);
+        }
+
+        if (socketActivation == false and instances == 1) {
+            localServerSocket->close();
+        }
+
+        localServerClock.start();
+
+        qApp->setProperty("localServerRestarts", 0);
+        qApp->setProperty("localServerDowntime", 0);
+
+        localServerTester = new QTimer(this);
+        localServerTester->setSingleShot(true);
+
+        QObject::connect(localServerTester, SIGNAL(timeout()),
                          this, SLOT(qLocalServerPingSlot()));
-        localServerTester->start(1000);
+
+        qStartLocalServerSlot();
     }
 }
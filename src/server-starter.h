@@ -16,11 +16,31 @@
 */
 
 #include <QtWidgets/QApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QHash>
+#include <QHostAddress>
 #include <QObject>
+#include <QPointer>
+#include <QTcpServer>
 #include <QTimer>
 #include <QTcpSocket>
 #include <QUrl>
 
+#include "child-process.h"
+#include "load-balancer.h"
+#include "probes.h"
+#include "trace-recorder.h"
+
+#if QT_VERSION > QT_VERSION_CHECK(5, 5, 0)
+#if ANNULEN_QTWEBKIT == 0
+#ifndef Q_OS_WIN
+#define PEB_FASTCGI_MODE
+#include "fastcgi-handler.h"
+#endif
+#endif
+#endif
+
 #ifndef SERVER_STARTER_H
 #define SERVER_STARTER_H
 
@@ -34,17 +54,194 @@ class QServerStarter : public QObject
 signals:
     void loadUrlSignal(QUrl url);
     void displayErrorSignal(QString errorString);
+    void localServerRestartedSignal();
+    void localServerStoppedSignal();
 
 public slots:
+    void qStartLocalServerSlot()
+    {
+        foreach (QChildProcess *instance, localServers) {
+            qStartInstance(instance);
+        }
+    }
+
+    void qStartInstance(QChildProcess *instance)
+    {
+        if (localServerStopping == true) {
+            return;
+        }
+
+        qSetInstanceReady(instance, false);
+        instance->setProperty("startTime", localServerClock.elapsed());
+
+        // The reserved port is released only immediately before
+        // the instance is started to bind it:
+        if (portReservations.contains(instance)) {
+            portReservations[instance]->close();
+        }
+
+        QTraceRecorder::instance()->qBegin(
+                    "local-server", "instance startup",
+                    instance->property("instance").toString());
+
+        // Program and arguments of every instance are set only once:
+        instance->start();
+
+        if (socketActivation == true) {
+            // Connections are accepted in the backlog of
+            // the inherited socket, so no ping is necessary:
+            QTimer::singleShot(0, instance, [this, instance]() {
+                qInstanceReady(instance);
+            });
+            return;
+        }
+
+        // Local server instances are pinged with
+        // non-blocking connection attempts
+        // starting 5 milliseconds after they are launched and
+        // doubling the interval between them up to 250 milliseconds.
+        // The index page is loaded as soon as an instance accepts
+        // a connection and a timeout message is displayed if
+        // no instance is available after the configured timeout.
+        localServerPingInterval = 5;
+        localServerWait.start();
+        localServerTester->start(localServerPingInterval);
+    }
+
     void qLocalServerPingSlot()
     {
-        QTcpSocket localWebServerPing;
-        localWebServerPing.connectToHost ("127.0.0.1",
-                                          qApp->property("port").toInt());
+        bool instancesWaiting = false;
 
-        // Local server is pinged every second until ready:
-        if (localWebServerPing.waitForConnected (1000)) {
-            localServerTester->stop();
+        // Instances waiting for a restart are not pinged,
+        // but they still count for the timeout:
+        foreach (QChildProcess *instance, localServers) {
+            if (instance->property("ready").toBool() == false) {
+                instancesWaiting = true;
+            }
+
+            if (instance->property("ready").toBool() == false and
+                    instance->state() != QProcess::NotRunning) {
+                PEB_PROBE2(server__ping,
+                           instance->property("instance").toInt(),
+                           localServerPingInterval);
+
+                // Every ping is a non-blocking connection attempt and
+                // its result is handled by the two slots below:
+                QTcpSocket *ping = new QTcpSocket(instance);
+
+                QObject::connect(ping, SIGNAL(connected()),
+                                 this, SLOT(qLocalServerReadySlot()));
+
+                QObject::connect(ping,
+                                 SIGNAL(error(QAbstractSocket::SocketError)),
+                                 ping,
+                                 SLOT(deleteLater()));
+
+                ping->connectToHost(QHostAddress::LocalHost,
+                                    instance->property("port").toInt());
+            }
+        }
+
+        if (instancesWaiting == false) {
+            return;
+        }
+
+        if (localServerWait.elapsed() >= localServerTimeout) {
+            if (localServerLoaded == false) {
+                displayErrorSignal(QString("Local server timed out."));
+            } else {
+                localServerLog.write("Local server instance timed out.\n");
+                localServerLog.flush();
+            }
+            return;
+        }
+
+        // Local server is pinged again after an exponential backoff
+        // starting from a few milliseconds:
+        localServerPingInterval =
+                qMin(localServerPingInterval * 2, localServerMaximumInterval);
+
+        localServerTester->start(localServerPingInterval);
+    }
+
+    void qLocalServerReadySlot()
+    {
+        QTcpSocket *ping = qobject_cast<QTcpSocket*>(sender());
+
+        if (ping == NULL) {
+            return;
+        }
+
+        QChildProcess *instance = qobject_cast<QChildProcess*>(ping->parent());
+
+        ping->abort();
+        ping->deleteLater();
+
+        if (instance != NULL) {
+            qInstanceReady(instance);
+        }
+    }
+
+    void qSetInstanceReady(QChildProcess *instance, bool ready)
+    {
+        instance->setProperty("ready", ready);
+
+        // The load balancer keeps its own copy of the instance state:
+        if (loadBalancer != NULL) {
+            QMetaObject::invokeMethod(
+                        loadBalancer, "qBackendReadySlot",
+                        Qt::QueuedConnection,
+                        Q_ARG(int, instance->property("instance").toInt() - 1),
+                        Q_ARG(bool, ready));
+        }
+    }
+
+    void qInstanceReady(QChildProcess *instance)
+    {
+        if (instance->state() == QProcess::NotRunning or
+                instance->property("ready").toBool() == true) {
+            return;
+        }
+
+        qSetInstanceReady(instance, true);
+
+        QTraceRecorder::instance()->qEnd(
+                    "local-server", "instance startup",
+                    instance->property("instance").toString());
+
+        PEB_PROBE2(server__ready,
+                   instance->property("instance").toInt(),
+                   (long long) (localServerClock.elapsed() -
+                                instance->property("startTime").toLongLong()));
+
+        qint64 downSince = instance->property("downSince").toLongLong();
+
+        if (downSince >= 0) {
+            instance->setProperty("downSince", -1);
+
+            qint64 downtime = localServerClock.elapsed() - downSince;
+            qApp->setProperty(
+                        "localServerDowntime",
+                        qApp->property("localServerDowntime").toLongLong() +
+                        downtime);
+
+            localServerLog.write(
+                        QString("Local server instance " +
+                                instance->property("instance").toString() +
+                                " restarted after " +
+                                QString::number(downtime) +
+                                " ms of downtime.\n").toUtf8());
+            localServerLog.flush();
+
+            // A single instance can not be replaced by other instances
+            // during its downtime and the page is reloaded:
+            if (localServers.length() == 1) {
+                emit localServerRestartedSignal();
+            }
+        }
+
+        if (localServerLoaded == false) {
+            localServerLoaded = true;
 
             QString localServerBaseUrl = "http://localhost:" +
                     qApp->property("port").toString() + "/";
@@ -52,18 +249,295 @@ public slots:
 
             loadUrlSignal(QUrl(localServerBaseUrl));
         }
+    }
+
+    // ==============================
+    // Local server supervision:
+    // ==============================
+    void qLocalServerOutputSlot()
+    {
+        QChildProcess *instance = qobject_cast<QChildProcess*>(sender());
 
-        localServerWait++;
+        localServerLog.write(instance->readAllStandardOutput());
+        localServerLog.flush();
+    }
+
+    void qLocalServerFinishedSlot(int exitCode,
+                                  QProcess::ExitStatus exitStatus)
+    {
+        QChildProcess *instance = qobject_cast<QChildProcess*>(sender());
+
+        qRestartInstance(instance,
+                         "exited with code " + QString::number(exitCode) +
+                         (exitStatus == QProcess::CrashExit ?
+                              QString(" after a crash") : QString("")));
+    }
 
-        if (localServerWait > 5) {
+    void qLocalServerErrorSlot(QProcess::ProcessError error)
+    {
+        // An instance which could not be started never emits finished(),
+        // so it is restarted from here.
+        // Other errors are followed by finished():
+        if (error != QProcess::FailedToStart) {
+            return;
+        }
+
+        QChildProcess *instance = qobject_cast<QChildProcess*>(sender());
+
+        qRestartInstance(instance,
+                         "failed to start: " + instance->errorString());
+    }
+
+    void qRestartInstance(QChildProcess *instance, QString reason)
+    {
+        qSetInstanceReady(instance, false);
+
+        if (localServerStopping == true) {
+            qLocalServerStopCheckSlot();
+            return;
+        }
+
+        // The port of the instance is reserved again
+        // until the instance is restarted:
+        if (portReservations.contains(instance)) {
+            QTcpServer *portReservation = portReservations[instance];
+
+            if (portReservation->listen(
+                        QHostAddress::LocalHost,
+                        instance->property("port").toInt())) {
+                portReservation->pauseAccepting();
+            }
+        }
+
+        localServerLog.write(
+                    QString("Local server instance " +
+                            instance->property("instance").toString() +
+                            " " + reason + ".\n").toUtf8());
+        localServerLog.flush();
+
+        // The restart delay is reset after a long enough uptime and
+        // doubled after every quick failure.
+        // An instance failing quickly too many times is not restarted.
+        int restartDelay = instance->property("restartDelay").toInt();
+        int quickFailures = instance->property("quickFailures").toInt();
+
+        qint64 uptime = localServerClock.elapsed() -
+                instance->property("startTime").toLongLong();
+
+        if (uptime > 30000) {
+            restartDelay = 100;
+            quickFailures = 0;
+        } else {
+            quickFailures++;
+        }
+
+        instance->setProperty("quickFailures", quickFailures);
+
+        if (quickFailures > localServerMaximumRestarts) {
+            displayErrorSignal(QString("Local server is not responding."));
+            return;
+        }
+
+        if (instance->property("downSince").toLongLong() < 0) {
+            instance->setProperty("downSince", localServerClock.elapsed());
+        }
+
+        qApp->setProperty("localServerRestarts",
+                          qApp->property("localServerRestarts").toInt() + 1);
+
+        QTimer::singleShot(restartDelay, instance, [this, instance]() {
+            qStartInstance(instance);
+        });
+
+        instance->setProperty("restartDelay", qMin(restartDelay * 2, 5000));
+    }
+
+    // ==============================
+    // Local server shutdown:
+    // The shutdown command, termination and killing of all instances
+    // follow each other without blocking the event loop and
+    // localServerStoppedSignal() is emitted when all processes exited
+    // or at most two and a quarter seconds after the start.
+    // ==============================
+    void qStopLocalServerSlot()
+    {
+        if (localServerStopping == true) {
+            return;
+        }
+
+        localServerStopping = true;
+
+        if (localServerTester != NULL) {
             localServerTester->stop();
-            displayErrorSignal(QString("Local server timed out."));
         }
+
+        if (loadBalancer != NULL) {
+            QMetaObject::invokeMethod(loadBalancer, "qStopSlot",
+                                      Qt::QueuedConnection);
+        }
+
+        foreach (QChildProcess *instance, localServers) {
+            stoppingProcesses.append(QPointer<QChildProcess>(instance));
+        }
+
+        // The shutdown command is sent directly to every instance and
+        // all instances are given a short time to exit on their own:
+        QString shutdownCommand =
+                qApp->property("shutdown_command").toString();
+
+        if (shutdownCommand.length() > 0 and !localServers.isEmpty()) {
+            QByteArray shutdownRequestData =
+                    QString("GET /" + shutdownCommand + " HTTP/1.0\r\n" +
+                            "Host: localhost\r\n\r\n").toUtf8();
+
+            foreach (QChildProcess *instance, localServers) {
+                if (instance->state() == QProcess::NotRunning) {
+                    continue;
+                }
+
+                QTcpSocket *shutdownRequest = new QTcpSocket(this);
+
+                QObject::connect(shutdownRequest, &QTcpSocket::connected,
+                                 [shutdownRequest, shutdownRequestData]() {
+                    shutdownRequest->write(shutdownRequestData);
+                    shutdownRequest->disconnectFromHost();
+                });
+
+                QObject::connect(shutdownRequest, SIGNAL(disconnected()),
+                                 shutdownRequest, SLOT(deleteLater()));
+
+                QObject::connect(shutdownRequest,
+                                 SIGNAL(error(QAbstractSocket::SocketError)),
+                                 shutdownRequest,
+                                 SLOT(deleteLater()));
+
+                shutdownRequest->connectToHost(
+                            QHostAddress::LocalHost,
+                            instance->property("port").toInt());
+            }
+
+            localServerStopPhase = 1;
+
+            QTimer::singleShot(250, this, SLOT(qTerminateLocalServerSlot()));
+            qLocalServerStopCheckSlot();
+            return;
+        }
+
+        qTerminateLocalServerSlot();
+    }
+
+    void qTerminateLocalServerSlot()
+    {
+        if (localServerStopPhase >= 2) {
+            return;
+        }
+
+        localServerStopPhase = 2;
+
+#ifdef PEB_FASTCGI_MODE
+        if (fastCgiHandler != NULL) {
+            fastCgiHandler->qStopWorkersSlot();
+
+            foreach (QChildProcess *worker, fastCgiHandler->workers) {
+                stoppingProcesses.append(QPointer<QChildProcess>(worker));
+
+                QObject::connect(worker,
+                                 SIGNAL(finished(int, QProcess::ExitStatus)),
+                                 this,
+                                 SLOT(qLocalServerStopCheckSlot()));
+            }
+        }
+#endif
+
+        // All instances and their worker processes are terminated at once
+        // and killed if they are still running after one second:
+        foreach (QPointer<QChildProcess> process, stoppingProcesses) {
+            if (!process.isNull()) {
+                process->terminateProcessGroup();
+            }
+        }
+
+        QTimer::singleShot(1000, this, SLOT(qKillLocalServerSlot()));
+        qLocalServerStopCheckSlot();
+    }
+
+    void qKillLocalServerSlot()
+    {
+        if (localServerStopPhase != 2) {
+            return;
+        }
+
+        localServerStopPhase = 3;
+
+        foreach (QPointer<QChildProcess> process, stoppingProcesses) {
+            if (!process.isNull()) {
+                process->killProcessGroup();
+            }
+        }
+
+        // Killed processes are given one more second to be reaped:
+        QTimer::singleShot(1000, this, SLOT(qLocalServerStoppedSlot()));
+        qLocalServerStopCheckSlot();
+    }
+
+    void qLocalServerStopCheckSlot()
+    {
+        if (localServerStopPhase == 0 or localServerStopPhase == 4) {
+            return;
+        }
+
+        foreach (QPointer<QChildProcess> process, stoppingProcesses) {
+            if (!process.isNull() and
+                    process->state() != QProcess::NotRunning) {
+                return;
+            }
+        }
+
+        // Instances which exited after the shutdown command
+        // still have their process groups terminated:
+        if (localServerStopPhase == 1) {
+            qTerminateLocalServerSlot();
+            return;
+        }
+
+        qLocalServerStoppedSlot();
+    }
+
+    void qLocalServerStoppedSlot()
+    {
+        if (localServerStopPhase == 4) {
+            return;
+        }
+
+        localServerStopPhase = 4;
+
+        emit localServerStoppedSignal();
     }
 
 public:
+    QList<QChildProcess*> localServers;
+    QTcpServer *localServerSocket;
+    QLoadBalancer *loadBalancer;
+    QHash<QChildProcess*, QTcpServer*> portReservations;
+    bool socketActivation;
+    bool fastCgiMode;
+#ifdef PEB_FASTCGI_MODE
+    QFastCgiHandler *fastCgiHandler;
+#endif
+
+    QFile localServerLog;
+    QElapsedTimer localServerClock;
+    bool localServerLoaded;
+    bool localServerStopping;
+    int localServerStopPhase;
+    QList<QPointer<QChildProcess> > stoppingProcesses;
+    int localServerMaximumRestarts;
+
     QTimer *localServerTester;
-    int localServerWait;
+    QElapsedTimer localServerWait;
+    int localServerPingInterval;
+    int localServerMaximumInterval;
+    int localServerTimeout;
 
     explicit QServerStarter(QString localServerSettingsFilePath);
 };
@@ -0,0 +1,35 @@
+/*
+ Perl Executing Browser
+
+ This program is free software;
+ you can redistribute it and/or modify it under the terms of the
+ GNU Lesser General Public License,
+ as published by the Free Software Foundation;
+ either version 3 of the License, or (at your option) any later version.
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY;
+ without even the implied warranty of MERCHANTABILITY or
+ FITNESS FOR A PARTICULAR PURPOSE.
+ Dimitar D. Mitov, 2013 - 2019
+ Valcho Nedelchev, 2014 - 2016
+ https://github.com/ddmitov/perl-executing-browser
+*/
+
+#include "shutdown-coordinator.h"
+
+// ==============================
+// SHUTDOWN COORDINATOR CONSTRUCTOR:
+// ==============================
+QShutdownCoordinator::QShutdownCoordinator()
+    : QObject(0)
+{
+    serverStarter = NULL;
+    scriptsPhase = 0;
+}
+
+QShutdownCoordinator *QShutdownCoordinator::instance()
+{
+    static QShutdownCoordinator *shutdownCoordinator =
+            new QShutdownCoordinator();
+    return shutdownCoordinator;
+}
@@ -0,0 +1,142 @@
+/*
+ Perl Executing Browser
+
+ This program is free software;
+ you can redistribute it and/or modify it under the terms of the
+ GNU Lesser General Public License,
+ as published by the Free Software Foundation;
+ either version 3 of the License, or (at your option) any later version.
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY;
+ without even the implied warranty of MERCHANTABILITY or
+ FITNESS FOR A PARTICULAR PURPOSE.
+ Dimitar D. Mitov, 2013 - 2019
+ Valcho Nedelchev, 2014 - 2016
+ https://github.com/ddmitov/perl-executing-browser
+*/
+
+#ifndef SHUTDOWN_COORDINATOR_H
+#define SHUTDOWN_COORDINATOR_H
+
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QJsonObject>
+#include <QObject>
+
+#include "request-statistics.h"
+#include "server-starter.h"
+#include "trace-recorder.h"
+
+// ==============================
+// SHUTDOWN COORDINATOR CLASS DEFINITION:
+// Bounded shutdown of scripts and local server with latency logging
+// ==============================
+class QShutdownCoordinator : public QObject
+{
+    Q_OBJECT
+
+public slots:
+    void qClosingScriptsSlot()
+    {
+        // Shutdown starts when the last open window is closed,
+        // so every closing window restarts the measurement:
+        shutdownTimer.start();
+        scriptsTimer.start();
+
+        QTraceRecorder::instance()->qBegin("shutdown", "scripts", "shutdown");
+    }
+
+    void qScriptsClosedSlot()
+    {
+        scriptsPhase = scriptsTimer.elapsed();
+        windowTimer.start();
+
+        QTraceRecorder::instance()->qEnd("shutdown", "scripts", "shutdown");
+        QTraceRecorder::instance()->qBegin("shutdown", "window", "shutdown");
+    }
+
+    void qExitSlot()
+    {
+        if (!shutdownTimer.isValid()) {
+            shutdownTimer.start();
+        }
+
+        qint64 windowPhase = 0;
+        if (windowTimer.isValid()) {
+            windowPhase = windowTimer.elapsed();
+
+            QTraceRecorder::instance()->qEnd("shutdown", "window", "shutdown");
+        }
+
+        QElapsedTimer serverTimer;
+        serverTimer.start();
+
+        qint64 serverSpan = QTraceRecorder::instance()->qNow();
+
+        // The local server is stopped without blocking and
+        // application events are processed until it is stopped:
+        if (serverStarter != NULL) {
+            QEventLoop stopLoop;
+            QObject::connect(serverStarter,
+                             SIGNAL(localServerStoppedSignal()),
+                             &stopLoop, SLOT(quit()));
+
+            serverStarter->qStopLocalServerSlot();
+
+            if (serverStarter->localServerStopPhase != 4) {
+                stopLoop.exec();
+            }
+        }
+
+        QTraceRecorder::instance()->qComplete(
+                    "shutdown", "local server", serverSpan);
+
+        qint64 serverPhase = serverTimer.elapsed();
+
+        // Request statistics are written in the data directory:
+        QString statisticsFileName =
+                qApp->property("requestStatisticsFile").toString();
+
+        if (statisticsFileName.length() > 0) {
+            QRequestStatistics::instance()->qWriteReport(
+                        QString::fromLatin1(qgetenv("PEB_DATA_DIR")) +
+                        "/" + statisticsFileName);
+        }
+
+        // Shutdown latency is always reported and
+        // is also recorded when a trace is recorded:
+        qint64 totalPhase = shutdownTimer.elapsed();
+
+        if (QTraceRecorder::instance()->enabled == true) {
+            QJsonObject latencyArguments;
+            latencyArguments["scripts"] = double(scriptsPhase);
+            latencyArguments["window"] = double(windowPhase);
+            latencyArguments["localServer"] = double(serverPhase);
+            latencyArguments["total"] = double(totalPhase);
+            QTraceRecorder::instance()->qInstant(
+                        "shutdown", "latency", latencyArguments);
+        }
+
+        qDebug("Shutdown latency: "
+               "scripts %lld ms, window %lld ms, "
+               "local server %lld ms, total %lld ms",
+               (long long) scriptsPhase,
+               (long long) windowPhase,
+               (long long) serverPhase,
+               (long long) totalPhase);
+    }
+
+public:
+    static QShutdownCoordinator *instance();
+    QServerStarter *serverStarter;
+
+private:
+    QShutdownCoordinator();
+
+    QElapsedTimer shutdownTimer;
+    QElapsedTimer scriptsTimer;
+    QElapsedTimer windowTimer;
+    qint64 scriptsPhase;
+};
+
+#endif // SHUTDOWN_COORDINATOR_H
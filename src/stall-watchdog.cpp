@@ -0,0 +1,229 @@
+/*
+ Perl Executing Browser
+
+ This program is free software;
+ you can redistribute it and/or modify it under the terms of the
+ GNU Lesser General Public License,
+ as published by the Free Software Foundation;
+ either version 3 of the License, or (at your option) any later version.
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY;
+ without even the implied warranty of MERCHANTABILITY or
+ FITNESS FOR A PARTICULAR PURPOSE.
+ Dimitar D. Mitov, 2013 - 2019
+ Valcho Nedelchev, 2014 - 2016
+ https://github.com/ddmitov/perl-executing-browser
+*/
+
+#include <QCoreApplication>
+#include <QMetaEnum>
+
+#include <signal.h>
+
+#if defined(Q_OS_LINUX) && defined(__GLIBC__)
+#include <execinfo.h>
+#include <pthread.h>
+#include <stdlib.h>
+
+#define PEB_STACK_SAMPLES
+#endif
+
+#include "stall-watchdog.h"
+
+// ==============================
+// STALL SCOPE:
+// ==============================
+QAtomicPointer<const char> QStallWatchdog::scope(NULL);
+
+QStallScope::QStallScope(const char *name)
+{
+    previousScope = QStallWatchdog::scope.fetchAndStoreRelease(name);
+}
+
+QStallScope::~QStallScope()
+{
+    QStallWatchdog::scope.storeRelease(previousScope);
+}
+
+// ==============================
+// Stack samples:
+// The GUI thread records its own stack in a signal handler and
+// the watchdog thread converts the addresses to symbols.
+// ==============================
+#ifdef PEB_STACK_SAMPLES
+static void *stackFrames[64];
+static QAtomicInt stackDepth(-1);
+static pthread_t guiThread;
+
+static void qStackSignalHandler(int signalNumber)
+{
+    Q_UNUSED(signalNumber);
+    stackDepth.storeRelease(backtrace(stackFrames, 64));
+}
+#endif
+
+// ==============================
+// STALL WATCHDOG CONSTRUCTOR:
+// ==============================
+QStallWatchdog::QStallWatchdog()
+    : QThread(0)
+{
+    heartbeatTimer = NULL;
+    heartbeatInterval = 50;
+    threshold = 0;
+
+    heartbeat.storeRelease(0);
+    eventReceiver.storeRelease(NULL);
+    eventType.storeRelease(0);
+}
+
+QStallWatchdog *QStallWatchdog::instance()
+{
+    static QStallWatchdog *stallWatchdog = new QStallWatchdog();
+    return stallWatchdog;
+}
+
+void QStallWatchdog::qStart(int stallThreshold)
+{
+    if (stallThreshold <= 0 or isRunning()) {
+        return;
+    }
+
+    threshold = qMax(stallThreshold, 2 * heartbeatInterval);
+
+#ifdef PEB_STACK_SAMPLES
+    // The first backtrace loads the unwinder library,
+    // which is not safe in a signal handler:
+    void *warmUpFrame[1];
+    backtrace(warmUpFrame, 1);
+
+    guiThread = pthread_self();
+
+    struct sigaction stackSampleAction;
+    sigemptyset(&stackSampleAction.sa_mask);
+    stackSampleAction.sa_handler = qStackSignalHandler;
+    stackSampleAction.sa_flags = SA_RESTART;
+    sigaction(SIGRTMIN, &stackSampleAction, NULL);
+#endif
+
+    stallClock.start();
+    heartbeat.storeRelease(stallClock.elapsed());
+
+    // The heartbeat is delayed only when the GUI event loop is blocked:
+    heartbeatTimer = new QTimer(this);
+    heartbeatTimer->setTimerType(Qt::PreciseTimer);
+
+    QObject::connect(heartbeatTimer, SIGNAL(timeout()),
+                     this, SLOT(qHeartbeatSlot()));
+
+    heartbeatTimer->start(heartbeatInterval);
+
+    qApp->installEventFilter(this);
+
+    QObject::connect(qApp, SIGNAL(aboutToQuit()), this, SLOT(qStopSlot()));
+
+    start(QThread::LowPriority);
+}
+
+// ==============================
+// Watchdog thread:
+// ==============================
+void QStallWatchdog::run()
+{
+    qint64 stalledHeartbeat = -1;
+    QString stallEvent;
+    QString stallScope;
+    QStringList stallStack;
+
+    while (!isInterruptionRequested()) {
+        QThread::msleep(heartbeatInterval / 2);
+
+        qint64 lastHeartbeat = heartbeat.loadAcquire();
+
+        // The culprit and the stack are sampled once per stall,
+        // as soon as the stall reaches the threshold:
+        if (stalledHeartbeat < 0 and
+                stallClock.elapsed() - lastHeartbeat - heartbeatInterval >=
+                threshold) {
+            stalledHeartbeat = lastHeartbeat;
+
+            const char *receiver = eventReceiver.loadAcquire();
+            stallEvent = QString::fromLatin1(receiver ? receiver : "none") +
+                    ", " + qEventName(eventType.loadAcquire());
+
+            const char *scopeName = scope.loadAcquire();
+            stallScope = QString::fromLatin1(scopeName ? scopeName : "none");
+
+            stallStack = qSampleStack();
+        }
+
+        // A stall is reported when the GUI event loop is running again:
+        if (stalledHeartbeat >= 0 and lastHeartbeat != stalledHeartbeat) {
+            QString report =
+                    "Event loop stall: " +
+                    QString::number(lastHeartbeat - stalledHeartbeat -
+                                    heartbeatInterval) + " ms\n" +
+                    "  event: " + stallEvent + "\n" +
+                    "  scope: " + stallScope + "\n";
+
+            if (stallStack.length() > 0) {
+                report.append("  stack:\n    " +
+                              stallStack.join("\n    ") + "\n");
+            }
+
+            qDebug("%s", report.toLocal8Bit().constData());
+
+            stalledHeartbeat = -1;
+        }
+    }
+}
+
+QString QStallWatchdog::qEventName(int type)
+{
+    QString eventName = "event type " + QString::number(type);
+
+#if QT_VERSION >= QT_VERSION_CHECK(5, 5, 0)
+    const char *typeName =
+            QMetaEnum::fromType<QEvent::Type>().valueToKey(type);
+
+    if (typeName != NULL) {
+        eventName.append(" (" + QString::fromLatin1(typeName) + ")");
+    }
+#endif
+
+    return eventName;
+}
+
+QStringList QStallWatchdog::qSampleStack()
+{
+    QStringList stack;
+
+#ifdef PEB_STACK_SAMPLES
+    stackDepth.storeRelease(-1);
+
+    if (pthread_kill(guiThread, SIGRTMIN) != 0) {
+        return stack;
+    }
+
+    for (int wait = 0; wait < 100 and stackDepth.loadAcquire() < 0; wait++) {
+        QThread::msleep(1);
+    }
+
+    int depth = stackDepth.loadAcquire();
+
+    if (depth > 0) {
+        char **symbols = backtrace_symbols(stackFrames, depth);
+
+        // The signal handler and the signal trampoline are skipped:
+        if (symbols != NULL) {
+            for (int frame = 2; frame < depth; frame++) {
+                stack.append(QString::fromLocal8Bit(symbols[frame]));
+            }
+
+            free(symbols);
+        }
+    }
+#endif
+
+    return stack;
+}
@@ -0,0 +1,103 @@
+/*
+ Perl Executing Browser
+
+ This program is free software;
+ you can redistribute it and/or modify it under the terms of the
+ GNU Lesser General Public License,
+ as published by the Free Software Foundation;
+ either version 3 of the License, or (at your option) any later version.
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY;
+ without even the implied warranty of MERCHANTABILITY or
+ FITNESS FOR A PARTICULAR PURPOSE.
+ Dimitar D. Mitov, 2013 - 2019
+ Valcho Nedelchev, 2014 - 2016
+ https://github.com/ddmitov/perl-executing-browser
+*/
+
+#ifndef STALL_WATCHDOG_H
+#define STALL_WATCHDOG_H
+
+#include <QAtomicInteger>
+#include <QAtomicPointer>
+#include <QElapsedTimer>
+#include <QEvent>
+#include <QStringList>
+#include <QThread>
+#include <QTimer>
+
+// ==============================
+// STALL SCOPE CLASS DEFINITION:
+// Code paths known to block the GUI thread are named,
+// so that stalls within them are attributed to them
+// ==============================
+class QStallScope
+{
+public:
+    explicit QStallScope(const char *name);
+    ~QStallScope();
+
+private:
+    const char *previousScope;
+};
+
+// ==============================
+// STALL WATCHDOG CLASS DEFINITION:
+// Stalls of the GUI event loop detected by a watchdog thread and
+// logged with the latest event, the running scope and a sampled stack
+// ==============================
+class QStallWatchdog : public QThread
+{
+    Q_OBJECT
+
+public slots:
+    void qHeartbeatSlot()
+    {
+        heartbeat.storeRelease(stallClock.elapsed());
+    }
+
+    void qStopSlot()
+    {
+        requestInterruption();
+        wait();
+    }
+
+public:
+    static QStallWatchdog *instance();
+
+    // The watchdog is started from the GUI thread and
+    // the stall threshold is set in milliseconds:
+    void qStart(int stallThreshold);
+
+    // All events delivered in the GUI thread are seen by
+    // this application-wide event filter:
+    bool eventFilter(QObject *receiver, QEvent *event)
+    {
+        eventReceiver.storeRelease(receiver->metaObject()->className());
+        eventType.storeRelease(int(event->type()));
+
+        return false;
+    }
+
+    static QAtomicPointer<const char> scope;
+
+protected:
+    void run();
+
+private:
+    QStallWatchdog();
+
+    static QString qEventName(int type);
+    QStringList qSampleStack();
+
+    QElapsedTimer stallClock;
+    QTimer *heartbeatTimer;
+    int heartbeatInterval;
+    int threshold;
+
+    QAtomicInteger<qint64> heartbeat;
+    QAtomicPointer<const char> eventReceiver;
+    QAtomicInt eventType;
+};
+
+#endif // STALL_WATCHDOG_H
@@ -0,0 +1,67 @@
+/*
+ Perl Executing Browser
+
+ This program is free software;
+ you can redistribute it and/or modify it under the terms of the
+ GNU Lesser General Public License,
+ as published by the Free Software Foundation;
+ either version 3 of the License, or (at your option) any later version.
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY;
+ without even the implied warranty of MERCHANTABILITY or
+ FITNESS FOR A PARTICULAR PURPOSE.
+ Dimitar D. Mitov, 2013 - 2019
+ Valcho Nedelchev, 2014 - 2016
+ https://github.com/ddmitov/perl-executing-browser
+*/
+#include <QtWidgets/QApplication>
+
+#include "startup-monitor.h"
+
+// ==============================
+// STARTUP MONITOR CONSTRUCTOR:
+// ==============================
+QStartupMonitor::QStartupMonitor()
+    : QObject(0)
+{
+    enginePhase = 0;
+    localServerPhase = -1;
+    reported = false;
+}
+
+QStartupMonitor *QStartupMonitor::instance()
+{
+    static QStartupMonitor *startupMonitor = new QStartupMonitor();
+    return startupMonitor;
+}
+
+// ==============================
+// First page:
+// ==============================
+void QStartupMonitor::qPageLoadedSlot(bool ok)
+{
+    if (reported == true) {
+        return;
+    }
+
+    reported = true;
+
+    QString localServerPhaseText;
+    if (localServerPhase >= 0) {
+        localServerPhaseText =
+                QString("local server ") +
+                QString::number(localServerPhase) + " ms, ";
+    }
+
+    // Startup latency is reported only by benchmark runs,
+    // which exit as soon as the first page is loaded:
+    if (qgetenv("PEB_STARTUP_BENCHMARK").length() > 0) {
+        qDebug("Startup latency: engine %lld ms, %sfirst page %lld ms%s",
+               (long long) enginePhase,
+               localServerPhaseText.toLatin1().constData(),
+               (long long) startupTimer.elapsed(),
+               ok ? "" : " (load failed)");
+
+        QApplication::quit();
+    }
+}
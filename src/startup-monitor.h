@@ -0,0 +1,64 @@
+/*
+ Perl Executing Browser
+
+ This program is free software;
+ you can redistribute it and/or modify it under the terms of the
+ GNU Lesser General Public License,
+ as published by the Free Software Foundation;
+ either version 3 of the License, or (at your option) any later version.
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY;
+ without even the implied warranty of MERCHANTABILITY or
+ FITNESS FOR A PARTICULAR PURPOSE.
+ Dimitar D. Mitov, 2013 - 2019
+ Valcho Nedelchev, 2014 - 2016
+ https://github.com/ddmitov/perl-executing-browser
+*/
+#ifndef STARTUP_MONITOR_H
+#define STARTUP_MONITOR_H
+
+#include <QElapsedTimer>
+#include <QObject>
+
+// ==============================
+// STARTUP MONITOR CLASS DEFINITION:
+// Startup latency logging and benchmarking
+// ==============================
+class QStartupMonitor : public QObject
+{
+    Q_OBJECT
+
+public slots:
+    void qEngineReadySlot()
+    {
+        enginePhase = startupTimer.elapsed();
+    }
+
+    void qLocalServerReadySlot()
+    {
+        if (localServerPhase < 0) {
+            localServerPhase = startupTimer.elapsed();
+        }
+    }
+
+    void qPageLoadedSlot(bool ok);
+
+public:
+    static QStartupMonitor *instance();
+
+    // The timer is started as the first action of the browser:
+    void qStart(QElapsedTimer timer)
+    {
+        startupTimer = timer;
+    }
+
+private:
+    QStartupMonitor();
+
+    QElapsedTimer startupTimer;
+    qint64 enginePhase;
+    qint64 localServerPhase;
+    bool reported;
+};
+
+#endif // STARTUP_MONITOR_H
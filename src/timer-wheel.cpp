@@ -0,0 +1,157 @@
+/*
+ Perl Executing Browser
+
+ This program is free software;
+ you can redistribute it and/or modify it under the terms of the
+ GNU Lesser General Public License,
+ as published by the Free Software Foundation;
+ either version 3 of the License, or (at your option) any later version.
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY;
+ without even the implied warranty of MERCHANTABILITY or
+ FITNESS FOR A PARTICULAR PURPOSE.
+ Dimitar D. Mitov, 2013 - 2019
+ Valcho Nedelchev, 2014 - 2016
+ https://github.com/ddmitov/perl-executing-browser
+*/
+
+#include <QMetaObject>
+
+#include "timer-wheel.h"
+
+// A wheel of 512 buckets with a resolution of 100 milliseconds
+// turns once in 51.2 seconds and
+// longer timeouts wait for the necessary number of rounds:
+#define WHEEL_BUCKETS 512
+
+// ==============================
+// TIMER WHEEL CONSTRUCTOR:
+// ==============================
+QTimerWheel::QTimerWheel()
+    : QObject(0)
+{
+    buckets.resize(WHEEL_BUCKETS);
+
+    lastTimeoutId = 0;
+    resolution = 100;
+    currentBucket = 0;
+    processedTicks = 0;
+
+    tickTimer = new QTimer(this);
+    tickTimer->setTimerType(Qt::CoarseTimer);
+
+    QObject::connect(tickTimer, SIGNAL(timeout()),
+                     this, SLOT(qTickSlot()));
+
+    wheelClock.start();
+}
+
+QTimerWheel *QTimerWheel::instance()
+{
+    static QTimerWheel *timerWheel = new QTimerWheel();
+    return timerWheel;
+}
+
+// ==============================
+// Scheduling:
+// ==============================
+quint64 QTimerWheel::qSchedule(QObject *target, const char *slot,
+                               qint64 delay)
+{
+    // The wheel is stopped while it is empty and
+    // its ticks start again from the current time:
+    if (timeouts.isEmpty()) {
+        processedTicks = wheelClock.elapsed() / resolution;
+        tickTimer->start(resolution);
+    }
+
+    // The deadline is rounded up to an absolute tick of the wheel clock,
+    // so that no timeout fires before its delay has elapsed,
+    // wherever the current tick is between two tick timer events:
+    qint64 deadline = wheelClock.elapsed() + qMax(delay, qint64(0));
+    qint64 deadlineTick = qMax(processedTicks + 1,
+                               (deadline + resolution - 1) / resolution);
+    qint64 ticks = deadlineTick - processedTicks;
+
+    QWheelTimeout timeout;
+    timeout.target = target;
+    timeout.slot = slot;
+    timeout.rounds = int((ticks - 1) / WHEEL_BUCKETS);
+
+    lastTimeoutId++;
+    timeouts.insert(lastTimeoutId, timeout);
+
+    int bucket = int((currentBucket + ticks) % WHEEL_BUCKETS);
+    buckets[bucket].append(lastTimeoutId);
+
+    return lastTimeoutId;
+}
+
+void QTimerWheel::qCancel(quint64 timeoutId)
+{
+    // Identifiers of cancelled timeouts are
+    // removed from their bucket when it is reached:
+    timeouts.remove(timeoutId);
+
+    if (timeouts.isEmpty()) {
+        tickTimer->stop();
+
+        for (int index = 0; index < buckets.size(); index++) {
+            buckets[index].clear();
+        }
+    }
+}
+
+quint64 QTimerWheel::qReschedule(quint64 timeoutId,
+                                 QObject *target,
+                                 const char *slot,
+                                 qint64 delay)
+{
+    if (timeoutId != 0) {
+        timeouts.remove(timeoutId);
+    }
+
+    return qSchedule(target, slot, delay);
+}
+
+// ==============================
+// Ticks:
+// ==============================
+void QTimerWheel::qTickSlot()
+{
+    // Ticks delayed by a busy event loop are caught up:
+    qint64 ticks = wheelClock.elapsed() / resolution;
+
+    while (processedTicks < ticks and !timeouts.isEmpty()) {
+        processedTicks++;
+        currentBucket = (currentBucket + 1) % WHEEL_BUCKETS;
+
+        QList<quint64> bucket = buckets[currentBucket];
+        buckets[currentBucket].clear();
+
+        foreach (quint64 timeoutId, bucket) {
+            if (!timeouts.contains(timeoutId)) {
+                continue;
+            }
+
+            if (timeouts[timeoutId].rounds > 0) {
+                timeouts[timeoutId].rounds--;
+                buckets[currentBucket].append(timeoutId);
+                continue;
+            }
+
+            QWheelTimeout timeout = timeouts.take(timeoutId);
+
+            if (!timeout.target.isNull()) {
+                QMetaObject::invokeMethod(timeout.target,
+                                          timeout.slot.constData());
+            }
+        }
+    }
+
+    processedTicks = ticks;
+
+    if (timeouts.isEmpty()) {
+        tickTimer->stop();
+    }
+}
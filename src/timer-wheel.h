@@ -0,0 +1,78 @@
+/*
+ Perl Executing Browser
+
+ This program is free software;
+ you can redistribute it and/or modify it under the terms of the
+ GNU Lesser General Public License,
+ as published by the Free Software Foundation;
+ either version 3 of the License, or (at your option) any later version.
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY;
+ without even the implied warranty of MERCHANTABILITY or
+ FITNESS FOR A PARTICULAR PURPOSE.
+ Dimitar D. Mitov, 2013 - 2019
+ Valcho Nedelchev, 2014 - 2016
+ https://github.com/ddmitov/perl-executing-browser
+*/
+
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <QPointer>
+#include <QTimer>
+#include <QVector>
+
+// ==============================
+// TIMER WHEEL CLASS DEFINITION:
+// Hashed timing wheel driving many coarse timeouts with a single timer
+// ==============================
+class QTimerWheel : public QObject
+{
+    Q_OBJECT
+
+public slots:
+    void qTickSlot();
+
+public:
+    static QTimerWheel *instance();
+
+    // The slot of the target is invoked once after the delay
+    // rounded up to the resolution of the wheel and never earlier.
+    // The returned identifier is never 0:
+    quint64 qSchedule(QObject *target, const char *slot, qint64 delay);
+    void qCancel(quint64 timeoutId);
+
+    // Moves a scheduled timeout, as needed for idle timeouts:
+    quint64 qReschedule(quint64 timeoutId,
+                        QObject *target,
+                        const char *slot,
+                        qint64 delay);
+
+private:
+    QTimerWheel();
+
+    struct QWheelTimeout
+    {
+        QPointer<QObject> target;
+        QByteArray slot;
+        int rounds;
+    };
+
+    QVector<QList<quint64> > buckets;
+    QHash<quint64, QWheelTimeout> timeouts;
+    quint64 lastTimeoutId;
+
+    int resolution;
+    int currentBucket;
+    qint64 processedTicks;
+
+    QTimer *tickTimer;
+    QElapsedTimer wheelClock;
+};
+
+#endif // TIMER_WHEEL_H
@@ -0,0 +1,163 @@
+/*
+ Perl Executing Browser
+
+ This program is free software;
+ you can redistribute it and/or modify it under the terms of the
+ GNU Lesser General Public License,
+ as published by the Free Software Foundation;
+ either version 3 of the License, or (at your option) any later version.
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY;
+ without even the implied warranty of MERCHANTABILITY or
+ FITNESS FOR A PARTICULAR PURPOSE.
+ Dimitar D. Mitov, 2013 - 2019
+ Valcho Nedelchev, 2014 - 2016
+ https://github.com/ddmitov/perl-executing-browser
+*/
+#include <QCoreApplication>
+#include <QJsonDocument>
+
+#include "trace-recorder.h"
+
+// ==============================
+// TRACE RECORDER CONSTRUCTOR:
+// ==============================
+QTraceRecorder::QTraceRecorder()
+{
+    enabled = false;
+}
+
+QTraceRecorder *QTraceRecorder::instance()
+{
+    static QTraceRecorder *traceRecorder = new QTraceRecorder();
+    return traceRecorder;
+}
+
+// ==============================
+// Trace file:
+// ==============================
+void QTraceRecorder::qOpen(QString traceFilePath, QElapsedTimer timer)
+{
+    traceTimer = timer;
+
+    traceFile.setFileName(traceFilePath);
+
+    // The JSON array format of the Chrome Trace Event format
+    // is valid without its closing bracket,
+    // so every event is written immediately and
+    // the trace of a crashed browser can still be loaded:
+    if (traceFile.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        traceFile.write("[\n");
+        enabled = true;
+
+        QJsonObject processName;
+        processName["name"] = QString("Perl Executing Browser");
+
+        QJsonObject metadata;
+        metadata["name"] = QString("process_name");
+        metadata["ph"] = QString("M");
+        metadata["args"] = processName;
+
+        qWriteEvent(metadata);
+    }
+}
+
+void QTraceRecorder::qClose()
+{
+    if (enabled == true) {
+        enabled = false;
+
+        traceFile.write("{}]\n");
+        traceFile.close();
+    }
+}
+
+qint64 QTraceRecorder::qNow()
+{
+    return traceTimer.nsecsElapsed() / 1000;
+}
+
+// ==============================
+// Trace events:
+// ==============================
+void QTraceRecorder::qComplete(QString category, QString name, qint64 start,
+                               QJsonObject arguments)
+{
+    if (enabled == false) {
+        return;
+    }
+
+    QJsonObject event;
+    event["cat"] = category;
+    event["name"] = name;
+    event["ph"] = QString("X");
+    event["ts"] = start;
+    event["dur"] = qNow() - start;
+    event["args"] = arguments;
+
+    qWriteEvent(event);
+}
+
+void QTraceRecorder::qBegin(QString category, QString name, QString id,
+                            QJsonObject arguments)
+{
+    if (enabled == false) {
+        return;
+    }
+
+    QJsonObject event;
+    event["cat"] = category;
+    event["name"] = name;
+    event["ph"] = QString("b");
+    event["id"] = id;
+    event["ts"] = qNow();
+    event["args"] = arguments;
+
+    qWriteEvent(event);
+}
+
+void QTraceRecorder::qEnd(QString category, QString name, QString id,
+                          QJsonObject arguments)
+{
+    if (enabled == false) {
+        return;
+    }
+
+    QJsonObject event;
+    event["cat"] = category;
+    event["name"] = name;
+    event["ph"] = QString("e");
+    event["id"] = id;
+    event["ts"] = qNow();
+    event["args"] = arguments;
+
+    qWriteEvent(event);
+}
+
+void QTraceRecorder::qInstant(QString category, QString name,
+                              QJsonObject arguments)
+{
+    if (enabled == false) {
+        return;
+    }
+
+    QJsonObject event;
+    event["cat"] = category;
+    event["name"] = name;
+    event["ph"] = QString("i");
+    event["s"] = QString("p");
+    event["ts"] = qNow();
+    event["args"] = arguments;
+
+    qWriteEvent(event);
+}
+
+void QTraceRecorder::qWriteEvent(QJsonObject event)
+{
+    event["pid"] = QCoreApplication::applicationPid();
+    event["tid"] = 1;
+
+    traceFile.write(QJsonDocument(event).toJson(QJsonDocument::Compact));
+    traceFile.write(",\n");
+    traceFile.flush();
+}
@@ -0,0 +1,67 @@
+/*
+ Perl Executing Browser
+
+ This program is free software;
+ you can redistribute it and/or modify it under the terms of the
+ GNU Lesser General Public License,
+ as published by the Free Software Foundation;
+ either version 3 of the License, or (at your option) any later version.
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY;
+ without even the implied warranty of MERCHANTABILITY or
+ FITNESS FOR A PARTICULAR PURPOSE.
+ Dimitar D. Mitov, 2013 - 2019
+ Valcho Nedelchev, 2014 - 2016
+ https://github.com/ddmitov/perl-executing-browser
+*/
+#ifndef TRACE_RECORDER_H
+#define TRACE_RECORDER_H
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonObject>
+#include <QString>
+
+// ==============================
+// TRACE RECORDER CLASS DEFINITION:
+// Timestamped spans in the Chrome Trace Event format
+// loadable in Perfetto or chrome://tracing
+// ==============================
+class QTraceRecorder
+{
+public:
+    static QTraceRecorder *instance();
+
+    // Events are recorded only after a trace file is opened.
+    // Timestamps are microseconds since the start of the browser:
+    void qOpen(QString traceFilePath, QElapsedTimer timer);
+    void qClose();
+
+    qint64 qNow();
+
+    // A span of the main thread ending now:
+    void qComplete(QString category, QString name, qint64 start,
+                   QJsonObject arguments = QJsonObject());
+
+    // Spans overlapping other spans, like running scripts,
+    // are identified by their category, name and id:
+    void qBegin(QString category, QString name, QString id,
+                QJsonObject arguments = QJsonObject());
+    void qEnd(QString category, QString name, QString id,
+              QJsonObject arguments = QJsonObject());
+
+    void qInstant(QString category, QString name,
+                  QJsonObject arguments = QJsonObject());
+
+    bool enabled;
+
+private:
+    QTraceRecorder();
+
+    void qWriteEvent(QJsonObject event);
+
+    QFile traceFile;
+    QElapsedTimer traceTimer;
+};
+
+#endif // TRACE_RECORDER_H
@@ -65,20 +65,12 @@ public slots:
 
     void closeEvent(QCloseEvent *event)
     {
-        if (qApp->property("windowCloseRequested").toBool() == false) {
+        if (property("windowCloseRequested").toBool() == false) {
             event->ignore();
             emit startMainWindowClosingSignal();
         }
 
-        if (qApp->property("windowCloseRequested").toBool() == true) {
-            if (qApp->property("shutdown_command").toString().length() > 0) {
-                QString shutdownUrl =
-                        qApp->property("local_server_base_url").toString() +
-                        qApp->property("shutdown_command").toString();
-
-                webViewWidget->setUrl(QUrl(shutdownUrl));
-            }
-
+        if (property("windowCloseRequested").toBool() == true) {
             event->accept();
         }
     }
@@ -91,6 +83,10 @@ public slots:
 public:
     QWebEngineView *webViewWidget;
     explicit QMainBrowserWindow(QWidget *parent = 0);
+
+    // A page is opened in a new window. Without a page
+    // the last active window is raised or the start page is opened:
+    static void qShowWindow(QUrl url);
 };
 
 #endif // MAIN_WINDOW_H
@@ -24,15 +24,15 @@
 // LOCAL PAGE CLASS CONSTRUCTOR:
 // (QTWEBENGINE VERSION)
 // ==============================
-QPage::QPage()
-    : QWebEnginePage()
+QPage::QPage(QObject *parent)
+    : QWebEnginePage(parent)
 {
     // QWebPage settings:
     QWebEngineSettings::globalSettings()->
             setDefaultTextEncoding(QString("utf-8"));
 
     QWebEngineSettings::globalSettings()->
-            setAttribute(QWebEngineSettings::JavascriptCanOpenWindows, false);
+            setAttribute(QWebEngineSettings::JavascriptCanOpenWindows, true);
 
     QWebEngineSettings::globalSettings()->
             setAttribute(QWebEngineSettings::AutoLoadImages, true);
@@ -44,14 +44,34 @@ QPage::QPage()
             setAttribute(QWebEngineSettings::LocalContentCanAccessRemoteUrls,
                          true);
     QWebEngineSettings::globalSettings()->
-            setAttribute(QWebEngineSettings::PluginsEnabled, true);
+            setAttribute(QWebEngineSettings::PluginsEnabled,
+                         qApp->property("pluginsEnabled").toBool());
     QWebEngineSettings::globalSettings()->
             setAttribute(QWebEngineSettings::XSSAuditingEnabled, true);
 
+    // Signal and slot for tracing page loads:
+    QObject::connect(this, SIGNAL(loadStarted()),
+                     this, SLOT(qPageLoadStartedSlot()));
+
     // Signal and slot for actions taken after page is loaded:
     QObject::connect(this, SIGNAL(loadFinished(bool)),
                      this, SLOT(qPageLoadedSlot(bool)));
 
+    // Resource Timing entries are collected regularly
+    // only if request statistics are enabled,
+    // because they are lost when another page is loaded:
+    if (qApp->property("requestStatistics").toBool() == true) {
+        QTimer *resourceTimingTimer = new QTimer(this);
+        QObject::connect(resourceTimingTimer, SIGNAL(timeout()),
+                         this, SLOT(qCollectResourceTimingsSlot()));
+        resourceTimingTimer->start(2000);
+    }
+
+    // Signal and slot for the state of the script queues:
+    QObject::connect(QScriptScheduler::instance(),
+                     SIGNAL(queueChangedSignal()),
+                     this, SLOT(qScriptQueueChangedSlot()));
+
     // Signal and slot for closing window from JavaScript:
     QObject::connect(this, SIGNAL(windowCloseRequested()),
                      this, SLOT(qCloseAllScriptsSlot()));
@@ -62,8 +82,46 @@ QPage::QPage()
     yesLabel = "Yes";
     noLabel = "No";
 
-    // Close requested indicator:
+    // Close requested indicators:
     closeRequested = false;
+    scriptsClosed = false;
+
+    // Window visibility indicator:
+    background = false;
+
+    // Script lifecycle markers are enabled with DevTools or by the page:
+    performanceMarks = qApp->property("performanceMarks").toBool();
+    scriptQueueFunction = false;
+
+    // Page lifecycle timer and delays in milliseconds, 0 if not set:
+    lifecycleTimer = new QTimer(this);
+    lifecycleTimer->setSingleShot(true);
+
+    QObject::connect(lifecycleTimer, SIGNAL(timeout()),
+                     this, SLOT(qLifecycleTimerSlot()));
+
+    freezeDelay = 0;
+    discardDelay = 0;
+    frozen = false;
+    frozenJavaScriptBytes = 0;
+    frozenJavaScriptDropped = 0;
+
+    // Time in milliseconds given to scripts for a graceful shutdown:
+    scriptsGracePeriod = 3000;
+}
+
+// ==============================
+// LOCAL PAGE CLASS DESTRUCTOR:
+// (QTWEBENGINE VERSION)
+// ==============================
+QPage::~QPage()
+{
+    // A page deleted before its scripts have finished,
+    // like the page of a window closed after the scripts timeout,
+    // frees their slots. Its script handlers kill their scripts:
+    QObject::disconnect(QScriptScheduler::instance(), 0, this, 0);
+    QScriptScheduler::instance()->qReleasePage(this);
+    QPeriodicScheduler::instance()->qRemovePage(this);
 }
 
 // ==============================
@@ -73,8 +131,26 @@ bool QPage::acceptNavigationRequest(const QUrl &url,
                                     QWebEnginePage::NavigationType type,
                                     bool isMainFrame)
 {
+    PEB_PROBE3(page__navigation, (void *) this, (int) type, isMainFrame);
+
+    // Request statistics of the local server:
+    if ((url.scheme() == "file" or url.host() == "localhost" or
+         url.scheme() == "local-server") and
+            type == QWebEnginePage::NavigationTypeLinkClicked and
+            url.fileName() == "request-statistics.function" and
+            isMainFrame == true) {
+        QMessageBox statisticsBox;
+        statisticsBox.setWindowTitle("Request Statistics");
+        statisticsBox.setText(QRequestStatistics::instance()->qHtmlReport());
+        statisticsBox.setDefaultButton(QMessageBox::Ok);
+        statisticsBox.exec();
+
+        return false;
+    }
+
     // Handle filesystem dialogs:
-    if ((url.scheme() == "file" or url.host() == "localhost") and
+    if ((url.scheme() == "file" or url.host() == "localhost" or
+         url.scheme() == "local-server") and
             type == QWebEnginePage::NavigationTypeLinkClicked and
             url.fileName().contains(".dialog") and
             isMainFrame == true) {
@@ -86,6 +162,16 @@ bool QPage::acceptNavigationRequest(const QUrl &url,
     if (url.scheme() == "file" and isMainFrame == true) {
         // Submitting special forms is a method to start local Perl scripts:
         if (type == QWebEnginePage::NavigationTypeFormSubmitted) {
+            if (url.fileName().contains(".cancel")) {
+                qCancelScript(url.fileName().replace(".cancel", ""));
+                return false;
+            }
+
+            if (url.fileName().contains(".stats")) {
+                qScriptStats(url.fileName().replace(".stats", ""));
+                return false;
+            }
+
             if (url.fileName().contains(".script")) {
                 qHandleScripts(url.fileName().replace(".script", ""));
                 return false;
@@ -95,6 +181,18 @@ bool QPage::acceptNavigationRequest(const QUrl &url,
         }
 
         if (type == QWebEnginePage::NavigationTypeLinkClicked) {
+            // Clicking special links cancels local Perl scripts:
+            if (url.fileName().contains(".cancel")) {
+                qCancelScript(url.fileName().replace(".cancel", ""));
+                return false;
+            }
+
+            // Clicking special links requests script statistics:
+            if (url.fileName().contains(".stats")) {
+                qScriptStats(url.fileName().replace(".stats", ""));
+                return false;
+            }
+
             // Clicking special links is
             // another method to start local Perl scripts:
             if (url.fileName().contains(".script")) {
@@ -24,13 +24,25 @@
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QMessageBox>
+#include <QPair>
 #include <QRegularExpression>
 #include <QTimer>
 #include <QUrl>
 #include <QWebEnginePage>
 
 #include "file-reader.h"
+#include "metrics.h"
+#include "periodic-scheduler.h"
+#include "probes.h"
+#include "request-statistics.h"
 #include "script-handler.h"
+#include "script-scheduler.h"
+#include "stall-watchdog.h"
+#include "trace-recorder.h"
+
+// Up to 4 MB of script output and errors are kept for a frozen page and
+// the oldest output is dropped if more output arrives:
+#define FROZEN_JAVASCRIPT_LIMIT (4 * 1024 * 1024)
 
 // ==============================
 // WEB PAGE CLASS DEFINITION:
@@ -42,11 +54,33 @@ class QPage : public QWebEnginePage
 
 signals:
     void pageLoadedSignal();
+    void closingScriptsSignal();
     void closeWindowSignal();
 
 public slots:
+    void qPageLoadStartedSlot()
+    {
+        // A new document has no state of the script queues:
+        scriptQueueFunction = false;
+        lastQueueStatus.clear();
+        lastPageQueueStatus.clear();
+
+        QTraceRecorder::instance()->qBegin(
+                    "page", "page load",
+                    QString::number((quintptr) this, 16));
+    }
+
     void qPageLoadedSlot(bool ok)
     {
+        QJsonObject loadTraceArguments;
+        loadTraceArguments["url"] = QPage::url().toString();
+        loadTraceArguments["ok"] = ok;
+
+        QTraceRecorder::instance()->qEnd(
+                    "page", "page load",
+                    QString::number((quintptr) this, 16),
+                    loadTraceArguments);
+
         if (ok) {
             if (QPage::url().scheme() == "file") {
                 // Inject all browser-specific Javascript:
@@ -54,7 +88,15 @@ public slots:
                         new QFileReader(QString(":/peb.js"));
                 QString pebJavaScript = resourceReader->fileContents;
 
-                QPage::runJavaScript(pebJavaScript);
+                QString pageTraceId = QString::number((quintptr) this, 16);
+
+                QTraceRecorder::instance()->qBegin(
+                            "page", "peb.js injection", pageTraceId);
+
+                QPage::runJavaScript(pebJavaScript, [pageTraceId](QVariant){
+                    QTraceRecorder::instance()->qEnd(
+                                "page", "peb.js injection", pageTraceId);
+                });
 
                 QPage::runJavaScript(
                             QString("peb.getPageSettings()"),
@@ -63,6 +105,9 @@ public slots:
                 });
             }
 
+            // Resource Timing entries of the start page are collected:
+            qCollectResourceTimingsSlot();
+
             // Send signal to the html-viewing class that a page is loaded:
             emit pageLoadedSignal();
 
@@ -84,6 +129,29 @@ public slots:
         }
     }
 
+    // ==============================
+    // Request statistics:
+    // ==============================
+    void qCollectResourceTimingsSlot()
+    {
+        // Requests of the FastCGI mode are recorded by its scheme handler.
+        // Requests to a local HTTP server are recorded from
+        // the Resource Timing entries of its pages:
+        QString localServerBaseUrl =
+                qApp->property("local_server_base_url").toString();
+
+        if (localServerBaseUrl.startsWith("http") and
+                QPage::url().toString().startsWith(localServerBaseUrl) and
+                frozen == false) {
+            QPage::runJavaScript(
+                        QRequestStatistics::resourceTimingsJavaScript,
+                        [](QVariant result){
+                QRequestStatistics::instance()->
+                        qRecordResourceTimings(result.toString());
+            });
+        }
+    }
+
     // ==============================
     // Page settings:
     // ==============================
@@ -94,6 +162,30 @@ public slots:
         if (!settingsJsonDocument.isEmpty()) {
             QJsonObject settingsJsonObject = settingsJsonDocument.object();
 
+            // Get the maximal number of scripts running for the page:
+            if (settingsJsonObject["maximumScripts"].toInt() > 0) {
+                QScriptScheduler::instance()->qSetPageLimit(
+                            this, settingsJsonObject["maximumScripts"].toInt());
+            }
+
+            // Script lifecycle markers in the performance timeline:
+            if (settingsJsonObject["performanceMarks"].toBool() == true) {
+                performanceMarks = true;
+            }
+
+            // Pages with a scriptQueueFunction get every queue change:
+            scriptQueueFunction =
+                    settingsJsonObject["scriptQueueFunction"].toBool(false);
+
+            // Get the delays in seconds after which
+            // a hidden page is frozen and discarded:
+            freezeDelay =
+                    qRound(settingsJsonObject["freezeDelay"].toDouble(0) *
+                           1000);
+            discardDelay =
+                    qRound(settingsJsonObject["discardDelay"].toDouble(0) *
+                           1000);
+
             // Get auto-start scripts:
             QJsonArray autoStartScripts =
                     settingsJsonObject["autoStartScripts"].toArray();
@@ -148,6 +240,8 @@ public slots:
     // ==============================
     void qHandleDialogs(QString dialogObjectName)
     {
+        QMetrics::instance()->bridgeCalls++;
+
         QPage::runJavaScript(
                     QString("peb.getDialogSettings(" +
                             dialogObjectName + ")"),
@@ -167,6 +261,8 @@ public slots:
 
     void qReadDialogSettings(QJsonObject dialogJsonObject)
     {
+        QStallScope stallScope("QPage::qReadDialogSettings");
+
         QString id = dialogJsonObject["id"].toString();
 
         QString type = dialogJsonObject["type"].toString();
@@ -223,6 +319,8 @@ public slots:
     // ==============================
     void qHandleScripts(QString scriptObjectName)
     {
+        QMetrics::instance()->bridgeCalls++;
+
         if (QPage::url().scheme() == "file") {
             QPage::runJavaScript(
                         QString("peb.getScriptSettings(" +
@@ -244,20 +342,80 @@ public slots:
 
     void qScriptStartedCheck(QJsonObject scriptJsonObject)
     {
-        // Start the script if it is not yet started:
-        if (!runningScripts.contains(scriptJsonObject["id"].toString())) {
-            qStartScript(scriptJsonObject);
+        QString scriptId = scriptJsonObject["id"].toString();
+
+        // Periodic scripts are registered when they are first started and
+        // are started again by the periodic scheduler:
+        if (closeRequested == false) {
+            QPeriodicScheduler::instance()->qRegister(this, scriptJsonObject);
         }
 
-        // Feed the script with data if it is already started:
-        if (runningScripts.contains(scriptJsonObject["id"].toString())) {
+        // Feed the script with data if it is already started.
+        // Resident periodic scripts without input data
+        // receive an empty line on every run:
+        if (runningScripts.contains(scriptId)) {
+            QPeriodicJob *periodicJob =
+                    QPeriodicScheduler::instance()->qJob(this, scriptId);
+
+            if (periodicJob != NULL and periodicJob->resident == true and
+                    scriptJsonObject["scriptInput"].toString().length() == 0) {
+                runningScripts.value(scriptId)->qWriteInput("\n");
+            }
+
             qFeedScript(scriptJsonObject);
+            return;
+        }
+
+        // Scripts waiting for a free slot keep their data
+        // until they are started:
+        if (QScriptScheduler::instance()->qAppendInput(
+                    this, scriptId,
+                    scriptJsonObject["scriptInput"].toString())) {
+            return;
+        }
+
+        // Start the script as soon as the scheduler allows it:
+        if (closeRequested == false) {
+            QScriptScheduler::instance()->qEnqueue(this, scriptJsonObject);
+        }
+    }
+
+    void qPeriodicTickSlot(QString scriptId)
+    {
+        QPeriodicJob *periodicJob =
+                QPeriodicScheduler::instance()->qJob(this, scriptId);
+
+        // A frozen page can not receive the output of the run:
+        if (frozen == true) {
+            if (periodicJob != NULL) {
+                periodicJob->skippedRuns++;
+            }
+            return;
+        }
+
+        // A run of a short-lived periodic script is skipped if
+        // the previous run is still running or waiting in a queue:
+        if (periodicJob != NULL and periodicJob->resident == false and
+                (runningScripts.contains(scriptId) or
+                 QScriptScheduler::instance()->qAppendInput(
+                     this, scriptId, QString()))) {
+            periodicJob->skippedRuns++;
+            return;
         }
+
+        qHandleScripts(scriptId);
+    }
+
+    void qStartQueuedScript(QJsonObject scriptJsonObject)
+    {
+        qStartScript(scriptJsonObject);
+        qFeedScript(scriptJsonObject);
     }
 
     void qStartScript(QJsonObject scriptJsonObject)
     {
-        QScriptHandler *scriptHandler = new QScriptHandler(scriptJsonObject);
+        QScriptHandler *scriptHandler =
+                new QScriptHandler(scriptJsonObject, this);
 
         QObject::connect(scriptHandler,
                          SIGNAL(displayScriptOutputSignal(QString,
@@ -271,10 +429,37 @@ public slots:
                          this,
                          SLOT(qDisplayScriptErrorsSlot(QString)));
 
-        QObject::connect(scriptHandler, SIGNAL(scriptFinishedSignal(QString)),
-                         this, SLOT(qScriptFinishedSlot(QString)));
+        QObject::connect(scriptHandler,
+                         SIGNAL(scriptFinishedSignal(QString, QJsonObject)),
+                         this,
+                         SLOT(qScriptFinishedSlot(QString, QJsonObject)));
+
+        QObject::connect(scriptHandler, SIGNAL(scriptIdleSignal(bool)),
+                         this, SLOT(qScriptIdleSlot(bool)));
+
+        if (background == true) {
+            scriptHandler->qSetBackground(true);
+        }
 
         runningScripts.insert(scriptJsonObject["id"].toString(), scriptHandler);
+
+        qScriptMark("peb.scriptMark('" + scriptJsonObject["id"].toString() +
+                    "', 'spawn');");
+    }
+
+    // ==============================
+    // Script lifecycle markers:
+    // Spawn, first output, every output batch and exit of
+    // every script are visible in the performance timeline of DevTools.
+    // ==============================
+    void qScriptMark(QString markJavaScript)
+    {
+        if (performanceMarks == true and QPage::url().scheme() == "file") {
+            qRunScriptJavaScript(
+                        "if (typeof peb !== 'undefined' && " +
+                        QString("typeof peb.scriptMark === 'function') {") +
+                        markJavaScript + "} null");
+        }
     }
 
     void qFeedScript(QJsonObject scriptJsonObject)
@@ -287,11 +472,264 @@ public slots:
         if (scriptInput.length() > 0) {
             QScriptHandler *handler =
                     runningScripts.value(scriptJsonObject["id"].toString());
-            if (handler->scriptProcess.isOpen()) {
-                handler->scriptProcess.write(scriptInput.toUtf8());
-                handler->scriptProcess.write(QString("\n").toLatin1());
+            handler->qWriteInput(scriptInput.toUtf8() + "\n");
+        }
+    }
+
+    void qScriptQueueChangedSlot()
+    {
+        // The state of the script queues is available to the page as
+        // peb.scriptQueue and is passed to
+        // the optional pebSettings.scriptQueueFunction.
+        // A frozen page gets the state of the queues when it is restored.
+        // Only changed states are pushed and pages without
+        // a scriptQueueFunction get only changes of their own scripts:
+        if (QPage::url().scheme() == "file" and frozen == false) {
+            QJsonObject status = QScriptScheduler::instance()->qStatus(this);
+
+            QByteArray statusJson =
+                    QJsonDocument(status).toJson(QJsonDocument::Compact);
+
+            QJsonObject pageStatus;
+            pageStatus["pageRunning"] = status["pageRunning"];
+            pageStatus["pageQueued"] = status["pageQueued"];
+            pageStatus["pageMaximum"] = status["pageMaximum"];
+
+            QByteArray pageStatusJson =
+                    QJsonDocument(pageStatus).toJson(QJsonDocument::Compact);
+
+            if (statusJson == lastQueueStatus or
+                    (scriptQueueFunction == false and
+                     pageStatusJson == lastPageQueueStatus)) {
+                return;
+            }
+
+            lastQueueStatus = statusJson;
+            lastPageQueueStatus = pageStatusJson;
+
+            QString scriptQueueJavaScript =
+                    "if (typeof peb !== 'undefined') {" +
+                    QString("peb.scriptQueue = ") +
+                    QString::fromUtf8(statusJson) +
+                    ";" +
+                    "if (typeof pebSettings !== 'undefined' && " +
+                    "typeof pebSettings.scriptQueueFunction === " +
+                    "'function') {" +
+                    "pebSettings.scriptQueueFunction(peb.scriptQueue);" +
+                    "}} null";
+
+            QPage::runJavaScript(scriptQueueJavaScript);
+        }
+    }
+
+    void qBackgroundChangedSlot(bool windowInBackground)
+    {
+        // Every script follows its own background policy:
+        background = windowInBackground;
+
+        foreach (QScriptHandler *handler, runningScripts.values()) {
+            handler->qSetBackground(background);
+        }
+
+        // A hidden page is frozen after its freeze delay and
+        // a visible page is restored immediately:
+        if (background == true and freezeDelay > 0) {
+            lifecycleTimer->start(freezeDelay);
+        }
+
+        if (background == false) {
+            lifecycleTimer->stop();
+            qRestorePage();
+        }
+    }
+
+    // ==============================
+    // Page lifecycle:
+    // Frozen pages have no running timers, animations or
+    // JavaScript tasks and discarded pages release their renderer memory.
+    // Both states are available only for Qt 5.14 or higher.
+    // ==============================
+    void qLifecycleTimerSlot()
+    {
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+        if (QPage::lifecycleState() == LifecycleState::Active) {
+            QPage::setVisible(false);
+
+            // Pages playing audio or having other
+            // activities visible to the user stay active:
+            if (QPage::recommendedState() == LifecycleState::Active) {
+                return;
+            }
+
+            QPage::setLifecycleState(LifecycleState::Frozen);
+            frozen = true;
+
+            if (discardDelay > freezeDelay) {
+                lifecycleTimer->start(discardDelay - freezeDelay);
+            }
+
+            return;
+        }
+
+        // A discarded page is loaded again when it is restored.
+        // Pages with running or periodic scripts are only frozen,
+        // because their scripts have to deliver output to the same page:
+        if (QPage::lifecycleState() == LifecycleState::Frozen and
+                runningScripts.isEmpty() and
+                !QPeriodicScheduler::instance()->qHasJobs(this)) {
+            QScriptScheduler::instance()->qRemovePage(this);
+
+            qClearFrozenJavaScript();
+            QPage::setLifecycleState(LifecycleState::Discarded);
+        }
+#endif
+    }
+
+    void qRestorePage()
+    {
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+        if (QPage::lifecycleState() != LifecycleState::Active) {
+            QPage::setLifecycleState(LifecycleState::Active);
+        }
+
+        if (!QPage::isVisible()) {
+            QPage::setVisible(true);
+        }
+#endif
+
+        if (frozen == true) {
+            frozen = false;
+
+            // Script output and errors buffered while the page was frozen
+            // are delivered in their original order:
+            if (frozenJavaScriptDropped > 0) {
+                QPage::runJavaScript(
+                            "console.log('PEB: " +
+                            QString::number(frozenJavaScriptDropped) +
+                            " script output batches were dropped " +
+                            "while the page was frozen.'); null");
+            }
+
+            for (int index = 0; index < frozenJavaScript.length(); index++) {
+                QPage::runJavaScript(frozenJavaScript[index].second);
+            }
+
+            qClearFrozenJavaScript();
+
+            qScriptQueueChangedSlot();
+        }
+    }
+
+    // JavaScript with a coalescing key replaces the buffered JavaScript
+    // with the same key while the page is frozen,
+    // so that only the latest statistics of every script are kept.
+    // The oldest JavaScript is dropped if the buffer is full:
+    void qRunScriptJavaScript(QString javaScript,
+                              QString coalescingKey = QString())
+    {
+        PEB_PROBE3(page__javascript, (void *) this,
+                   javaScript.length(), frozen);
+
+        if (frozen == false) {
+            QPage::runJavaScript(javaScript);
+            return;
+        }
+
+        if (coalescingKey.length() > 0) {
+            for (int index = 0; index < frozenJavaScript.length(); index++) {
+                if (frozenJavaScript[index].first == coalescingKey) {
+                    qDropFrozenJavaScript(index);
+                    break;
+                }
             }
         }
+
+        frozenJavaScript.append(qMakePair(coalescingKey, javaScript));
+
+        qint64 javaScriptBytes = javaScript.toUtf8().size();
+        frozenJavaScriptBytes = frozenJavaScriptBytes + javaScriptBytes;
+        QMetrics::instance()->outputBacklog += javaScriptBytes;
+
+        while (frozenJavaScriptBytes > FROZEN_JAVASCRIPT_LIMIT and
+               frozenJavaScript.length() > 1) {
+            qDropFrozenJavaScript(0);
+            frozenJavaScriptDropped++;
+        }
+    }
+
+    void qDropFrozenJavaScript(int index)
+    {
+        qint64 javaScriptBytes =
+                frozenJavaScript.takeAt(index).second.toUtf8().size();
+
+        frozenJavaScriptBytes = frozenJavaScriptBytes - javaScriptBytes;
+        QMetrics::instance()->outputBacklog -= javaScriptBytes;
+    }
+
+    void qClearFrozenJavaScript()
+    {
+        frozenJavaScript.clear();
+        frozenJavaScriptDropped = 0;
+
+        QMetrics::instance()->outputBacklog -= frozenJavaScriptBytes;
+        frozenJavaScriptBytes = 0;
+    }
+
+    void qCancelScript(QString scriptId)
+    {
+        QMetrics::instance()->bridgeCalls++;
+
+        // A running script is killed together with its process group and
+        // frees its slot when it exits. A waiting script is never started.
+        QPeriodicScheduler::instance()->qUnregister(this, scriptId);
+
+        if (runningScripts.contains(scriptId)) {
+            runningScripts.value(scriptId)->qCancelSlot();
+        } else {
+            QScriptScheduler::instance()->qCancel(this, scriptId);
+        }
+    }
+
+    // ==============================
+    // Resource accounting:
+    // Statistics of running and finished scripts are
+    // delivered to the peb.stats() callbacks of the page.
+    // ==============================
+    void qScriptStats(QString scriptId)
+    {
+        QMetrics::instance()->bridgeCalls++;
+
+        QJsonObject stats;
+
+        if (runningScripts.contains(scriptId)) {
+            stats = runningScripts.value(scriptId)->qStats();
+        } else {
+            stats["id"] = scriptId;
+            stats["state"] = "unknown";
+
+            QJsonArray queuedScripts = QScriptScheduler::instance()->
+                    qStatus(this).value("pageQueued").toArray();
+
+            if (queuedScripts.contains(QJsonValue(scriptId))) {
+                stats["state"] = "queued";
+            }
+        }
+
+        qSendScriptStats(scriptId, stats);
+    }
+
+    void qSendScriptStats(QString scriptId, QJsonObject stats)
+    {
+        if (QPage::url().scheme() == "file") {
+            QString statsJavaScript =
+                    "if (typeof peb !== 'undefined' && " +
+                    QString("typeof peb.receiveStats === 'function') {") +
+                    "peb.receiveStats('" + scriptId + "', " +
+                    QJsonDocument(stats).toJson(QJsonDocument::Compact) +
+                    ");} null";
+
+            qRunScriptJavaScript(statsJavaScript, "stats:" + scriptId);
+        }
     }
 
     void qDisplayScriptOutputSlot(QString id, QString output)
@@ -300,7 +738,26 @@ public slots:
             QString outputInsertionJavaScript =
                     id + ".stdoutFunction('" + output + "'); null";
 
-            QPage::runJavaScript(outputInsertionJavaScript);
+            QScriptHandler *handler = runningScripts.value(id);
+
+            if (performanceMarks == true and handler != NULL) {
+                if (handler->deliveries == 1) {
+                    qScriptMark("peb.scriptMark('" + id +
+                                "', 'first output');");
+                }
+
+                qScriptMark("peb.scriptOutputStart('" + id + "', " +
+                            QString::number(output.toUtf8().size()) + ", " +
+                            QString::number(handler->outputTime) + ");");
+
+                outputInsertionJavaScript.append(
+                            "; if (typeof peb !== 'undefined' && " +
+                            QString("typeof peb.scriptOutputEnd === ") +
+                            "'function') {peb.scriptOutputEnd('" + id +
+                            "');} null");
+            }
+
+            qRunScriptJavaScript(outputInsertionJavaScript);
         }
     }
 
@@ -316,17 +773,32 @@ public slots:
                 QString perlScriptErrorsMessage =
                         "console.log('" + errors + "'); null";
 
-                QPage::runJavaScript(perlScriptErrorsMessage);
+                qRunScriptJavaScript(perlScriptErrorsMessage);
             }
         }
     }
 
-    void qScriptFinishedSlot(QString scriptId)
+    void qScriptIdleSlot(bool idle)
+    {
+        QScriptScheduler::instance()->qScriptIdle(this, sender(), idle);
+    }
+
+    void qScriptFinishedSlot(QString scriptId, QJsonObject stats)
     {
-        runningScripts.remove(scriptId);
+        QScriptHandler *handler = runningScripts.take(scriptId);
+        if (handler != NULL) {
+            qScriptMark("peb.scriptExit('" + scriptId + "', " +
+                        QString::number(
+                            handler->scriptProcess.exitCode()) + ");");
+            qSendScriptStats(scriptId, stats);
+
+            handler->deleteLater();
+            QScriptScheduler::instance()->qScriptFinished(this,
+                                                          handler->idle);
+        }
 
         if (closeRequested == true and runningScripts.isEmpty()) {
-            emit closeWindowSignal();
+            qScriptsClosed();
         }
     }
 
@@ -352,73 +824,56 @@ public slots:
         jsCloseDecision = jsResult.toBool();
 
         if (jsCloseDecision == true) {
-            if (!runningScripts.isEmpty()){
-                qCloseAllScriptsSlot();
-            } else {
-                emit closeWindowSignal();
-            }
+            qCloseAllScriptsSlot();
         }
     }
 
     void qCloseAllScriptsSlot()
     {
-        closeRequested = true;
+        if (closeRequested == true) {
+            return;
+        }
 
-        if (!runningScripts.isEmpty()) {
-            QHash<QString, QScriptHandler*>::iterator iterator;
-            for (iterator = runningScripts.begin();
-                 iterator != runningScripts.end();
-                 ++iterator) {
-                QScriptHandler *handler = iterator.value();
-
-                if (handler->scriptProcess.isOpen()) {
-#ifndef Q_OS_WIN
-                    handler->scriptProcess.terminate();
-#endif
+        closeRequested = true;
+        emit closingScriptsSignal();
 
-#ifdef Q_OS_WIN
-                    handler->scriptProcess.kill();
-                    runningScripts.remove(iterator.key());
-#endif
-                }
+        // Waiting scripts are never started:
+        QScriptScheduler::instance()->qRemovePage(this);
+        QPeriodicScheduler::instance()->qRemovePage(this);
 
-                if (!handler->scriptProcess.isOpen()) {
-                    runningScripts.remove(iterator.key());
-                }
-            }
+        if (runningScripts.isEmpty()) {
+            qScriptsClosed();
+            return;
         }
 
-#ifndef Q_OS_WIN
-        if (!runningScripts.isEmpty()) {
-            int maximumTimeMilliseconds = 3000;
-            QTimer::singleShot(maximumTimeMilliseconds,
-                               this, SLOT(qScriptsTimeoutSlot()));
+        // All scripts and their child processes are signalled at once.
+        // The window is closed as soon as the last script has finished.
+        foreach (QScriptHandler *handler, runningScripts.values()) {
+            handler->scriptProcess.terminateProcessGroup();
         }
-#endif
 
-        if (runningScripts.isEmpty()) {
-            emit closeWindowSignal();
-        }
+        // Scripts still running after the grace period are killed:
+        QTimer::singleShot(scriptsGracePeriod,
+                           this, SLOT(qScriptsTimeoutSlot()));
     }
 
     void qScriptsTimeoutSlot()
     {
-#ifndef Q_OS_WIN
         if (!runningScripts.isEmpty()) {
-            QHash<QString, QScriptHandler*>::iterator iterator;
-            for (iterator = runningScripts.begin();
-                 iterator != runningScripts.end();
-                 ++iterator) {
-                QScriptHandler *handler = iterator.value();
-
-                if (handler->scriptProcess.isOpen()) {
-                    handler->scriptProcess.kill();
-                }
+            foreach (QScriptHandler *handler, runningScripts.values()) {
+                handler->scriptProcess.killProcessGroup();
             }
+
+            qScriptsClosed();
         }
+    }
 
-        emit closeWindowSignal();
-#endif
+    void qScriptsClosed()
+    {
+        if (scriptsClosed == false) {
+            scriptsClosed = true;
+            emit closeWindowSignal();
+        }
     }
 
 protected:
@@ -433,6 +888,8 @@ protected:
     {
         Q_UNUSED(url);
 
+        QStallScope stallScope("QPage::javaScriptAlert");
+
         QMessageBox javaScriptAlertMessageBox (qApp->activeWindow());
         javaScriptAlertMessageBox.setWindowModality(Qt::WindowModal);
         javaScriptAlertMessageBox.setWindowTitle(title());
@@ -449,6 +906,8 @@ protected:
     {
         Q_UNUSED(url);
 
+        QStallScope stallScope("QPage::javaScriptConfirm");
+
         QMessageBox javaScriptConfirmMessageBox (qApp->activeWindow());
         javaScriptConfirmMessageBox.setWindowModality(Qt::WindowModal);
         javaScriptConfirmMessageBox.setWindowTitle(title());
@@ -468,6 +927,8 @@ protected:
     {
         Q_UNUSED(url);
 
+        QStallScope stallScope("QPage::javaScriptPrompt");
+
         bool ok = false;
 
         QInputDialog dialog;
@@ -495,9 +956,25 @@ private:
     QString noLabel;
 
     bool closeRequested;
+    bool scriptsClosed;
+    bool background;
+    bool performanceMarks;
+    bool scriptQueueFunction;
+    QByteArray lastQueueStatus;
+    QByteArray lastPageQueueStatus;
+    int scriptsGracePeriod;
+
+    QTimer *lifecycleTimer;
+    int freezeDelay;
+    int discardDelay;
+    bool frozen;
+    QList<QPair<QString, QString> > frozenJavaScript;
+    qint64 frozenJavaScriptBytes;
+    int frozenJavaScriptDropped;
 
 public:
-    QPage();
+    explicit QPage(QObject *parent = 0);
+    ~QPage();
     QHash<QString, QScriptHandler*> runningScripts;
 };
 
@@ -17,6 +17,8 @@
 
 #include <webengine-view.h>
 
+#include "webengine-main-window.h"
+
 // ==============================
 // VIEW CLASS CONSTRUCTOR:
 // (QTWEBENGINE VERSION)
@@ -30,8 +32,8 @@ QViewWidget::QViewWidget()
     qApp->setProperty("pasteLabel", "Paste");
     qApp->setProperty("selectAllLabel", "Select All");
 
-    // Starting of a QPage instance:
-    mainPage = new QPage();
+    // Starting of a QPage instance deleted together with its window:
+    mainPage = new QPage(this);
 
     // Signal and slot for changing window title:
     QObject::connect(mainPage, SIGNAL(pageLoadedSignal()),
@@ -47,3 +49,29 @@ QViewWidget::QViewWidget()
     // Installing of the started QPage instance:
     setPage(mainPage);
 }
+
+// ==============================
+// New windows:
+// ==============================
+QWebEngineView *QViewWidget::createWindow(
+        QWebEnginePage::WebWindowType type)
+{
+    Q_UNUSED(type);
+
+    // Only local pages are allowed to open new windows.
+    // Remote pages can not spawn windows of the application:
+    QUrl openerUrl = page()->url();
+    if (openerUrl.scheme() != "file" and
+            openerUrl.host() != "localhost" and
+            openerUrl.scheme() != "local-server") {
+        return NULL;
+    }
+
+    // Windows opened by window.open() or peb.openWindow() share
+    // the browser engine, its caches and the script schedulers
+    // with all other windows of the application:
+    QMainBrowserWindow *window = new QMainBrowserWindow();
+    window->showMaximized();
+
+    return window->webViewWidget;
+}
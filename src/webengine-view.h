@@ -52,7 +52,8 @@ public slots:
     void contextMenuEvent(QContextMenuEvent *event)
     {
         if (QWebEngineView::page()->url().scheme() != "file" and
-                QWebEngineView::page()->url().host() != "localhost") {
+                QWebEngineView::page()->url().host() != "localhost" and
+                QWebEngineView::page()->url().scheme() != "local-server") {
             page()->action(QWebEnginePage::CopyImageToClipboard)->
                     setVisible(false);
             page()->action(QWebEnginePage::DownloadImageToDisk)->
@@ -73,7 +74,8 @@ public slots:
         }
 
         if (QWebEngineView::page()->url().scheme() == "file" or
-                QWebEngineView::page()->url().host() == "localhost") {
+                QWebEngineView::page()->url().host() == "localhost" or
+                QWebEngineView::page()->url().scheme() == "local-server") {
             QWebEngineContextMenuData contextMenuTest =
                     QWebEngineView::page()->contextMenuData();
             Q_ASSERT(contextMenuTest.isValid());
@@ -145,13 +147,17 @@ public slots:
     // ==============================
     void qCloseWindowSlot()
     {
-        qApp->setProperty("windowCloseRequested", true);
+        this->parentWidget()->setProperty("windowCloseRequested", true);
         this->parentWidget()->close();
     }
 
 public:
     QViewWidget();
 
+protected:
+    QWebEngineView *createWindow(
+            QWebEnginePage::WebWindowType type) override;
+
 private:
     QPage *mainPage;
 };
@@ -59,20 +59,12 @@ public slots:
 
     void closeEvent(QCloseEvent *event)
     {
-        if (qApp->property("windowCloseRequested").toBool() == false) {
+        if (property("windowCloseRequested").toBool() == false) {
             event->ignore();
             emit startMainWindowClosingSignal();
         }
 
-        if (qApp->property("windowCloseRequested").toBool() == true) {
-            if (qApp->property("shutdown_command").toString().length() > 0) {
-                QString shutdownUrl =
-                        qApp->property("local_server_base_url").toString() +
-                        qApp->property("shutdown_command").toString();
-
-                webViewWidget->setUrl(QUrl(shutdownUrl));
-            }
-
+        if (property("windowCloseRequested").toBool() == true) {
             event->accept();
         }
     }
@@ -85,6 +77,10 @@ public slots:
 public:
     QWebView *webViewWidget;
     explicit QMainBrowserWindow(QWidget *parent = 0);
+
+    // A page is opened in a new window. Without a page
+    // the last active window is raised or the start page is opened:
+    static void qShowWindow(QUrl url);
 };
 
 #endif // MAIN_WINDOW_H
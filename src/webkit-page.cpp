@@ -17,16 +17,19 @@
 
 #include <QNetworkAccessManager>
 #include <QNetworkCookieJar>
+#include <QNetworkDiskCache>
 #include <QNetworkProxyFactory>
 
+#include <climits>
+
 #include "webkit-page.h"
 
 // ==============================
 // LOCAL PAGE CLASS CONSTRUCTOR:
 // (QTWEBKIT VERSION)
 // ==============================
-QPage::QPage()
-    : QWebPage(0)
+QPage::QPage(QObject *parent)
+    : QWebPage(parent)
 {
     // QWebPage settings:
     QNetworkProxyFactory::setUseSystemConfiguration(true);
@@ -37,7 +40,7 @@ QPage::QPage()
     QWebSettings::globalSettings()->
             setAttribute(QWebSettings::JavaEnabled, false);
     QWebSettings::globalSettings()->
-            setAttribute(QWebSettings::JavascriptCanOpenWindows, false);
+            setAttribute(QWebSettings::JavascriptCanOpenWindows, true);
 
     QWebSettings::globalSettings()->
             setAttribute(QWebSettings::AutoLoadImages, true);
@@ -48,14 +51,70 @@ QPage::QPage()
     QWebSettings::globalSettings()->
             setAttribute(QWebSettings::LocalContentCanAccessRemoteUrls, true);
     QWebSettings::globalSettings()->
-            setAttribute(QWebSettings::PluginsEnabled, true);
+            setAttribute(QWebSettings::PluginsEnabled,
+                         qApp->property("pluginsEnabled").toBool());
     QWebSettings::globalSettings()->
             setAttribute(QWebSettings::XSSAuditingEnabled, true);
 
+    // Persistent HTTP cache in the data directory.
+    // Responses of the local server and remote assets are
+    // revalidated by the network access manager using their validators.
+    // All pages share one network access manager and its cache:
+    static QNetworkAccessManager *sharedNetworkAccessManager = NULL;
+
+    if (sharedNetworkAccessManager == NULL) {
+        sharedNetworkAccessManager = new QNetworkAccessManager(qApp);
+
+        QNetworkDiskCache *diskCache =
+                new QNetworkDiskCache(sharedNetworkAccessManager);
+        diskCache->setCacheDirectory(
+                    QString::fromLatin1(qgetenv("PEB_DATA_DIR")) +
+                    "/cache/engine");
+        diskCache->setMaximumCacheSize(
+                    qApp->property("httpCacheSize").toLongLong() *
+                    1024 * 1024);
+        sharedNetworkAccessManager->setCache(diskCache);
+    }
+
+    setNetworkAccessManager(sharedNetworkAccessManager);
+
+    // Memory caches of decoded resources and previous pages
+    // are limited only by the runtime profile.
+    // Their capacities are int numbers of bytes:
+    int memoryCacheSize =
+            int(qMin(qApp->property("memoryCacheSize").toLongLong() *
+                     1024 * 1024,
+                     qint64(INT_MAX)));
+
+    if (memoryCacheSize > 0) {
+        QWebSettings::setObjectCacheCapacities(
+                    0, memoryCacheSize / 2, memoryCacheSize);
+        QWebSettings::setMaximumPagesInCache(0);
+    }
+
+    // Signal and slot for tracing page loads:
+    QObject::connect(this, SIGNAL(loadStarted()),
+                     this, SLOT(qPageLoadStartedSlot()));
+
     // Signal and slot for actions taken after page is loaded:
     QObject::connect(this, SIGNAL(loadFinished(bool)),
                      this, SLOT(qPageLoadedSlot(bool)));
 
+    // Resource Timing entries are collected regularly
+    // only if request statistics are enabled,
+    // because they are lost when another page is loaded:
+    if (qApp->property("requestStatistics").toBool() == true) {
+        QTimer *resourceTimingTimer = new QTimer(this);
+        QObject::connect(resourceTimingTimer, SIGNAL(timeout()),
+                         this, SLOT(qCollectResourceTimingsSlot()));
+        resourceTimingTimer->start(2000);
+    }
+
+    // Signal and slot for the state of the script queues:
+    QObject::connect(QScriptScheduler::instance(),
+                     SIGNAL(queueChangedSignal()),
+                     this, SLOT(qScriptQueueChangedSlot()));
+
     // Signal and slot for closing window from JavaScript:
     QObject::connect(this, SIGNAL(windowCloseRequested()),
                      this, SLOT(qCloseAllScriptsSlot()));
@@ -66,6 +125,40 @@ QPage::QPage()
     yesLabel = "Yes";
     noLabel = "No";
 
-    // Close requested indicator:
+    // Close requested indicators:
     closeRequested = false;
+    scriptsClosed = false;
+
+    // Window visibility indicator:
+    background = false;
+
+    // Script lifecycle markers are enabled with DevTools or by the page:
+    performanceMarks = qApp->property("performanceMarks").toBool();
+    scriptQueueFunction = false;
+
+    // Page lifecycle timer and delay in milliseconds, 0 if not set:
+    lifecycleTimer = new QTimer(this);
+    lifecycleTimer->setSingleShot(true);
+
+    QObject::connect(lifecycleTimer, SIGNAL(timeout()),
+                     this, SLOT(qLifecycleTimerSlot()));
+
+    freezeDelay = 0;
+
+    // Time in milliseconds given to scripts for a graceful shutdown:
+    scriptsGracePeriod = 3000;
+}
+
+// ==============================
+// LOCAL PAGE CLASS DESTRUCTOR:
+// (QTWEBKIT VERSION)
+// ==============================
+QPage::~QPage()
+{
+    // A page deleted before its scripts have finished,
+    // like the page of a window closed after the scripts timeout,
+    // frees their slots. Its script handlers kill their scripts:
+    QObject::disconnect(QScriptScheduler::instance(), 0, this, 0);
+    QScriptScheduler::instance()->qReleasePage(this);
+    QPeriodicScheduler::instance()->qRemovePage(this);
 }
@@ -31,9 +31,17 @@
 #include <QWebElement>
 #include <QWebFrame>
 #include <QWebPage>
+#include <QWebSettings>
 
 #include "file-reader.h"
+#include "metrics.h"
+#include "periodic-scheduler.h"
+#include "probes.h"
+#include "request-statistics.h"
 #include "script-handler.h"
+#include "script-scheduler.h"
+#include "stall-watchdog.h"
+#include "trace-recorder.h"
 
 // ==============================
 // WEB PAGE CLASS DEFINITION:
@@ -45,11 +53,33 @@ class QPage : public QWebPage
 
 signals:
     void pageLoadedSignal();
+    void closingScriptsSignal();
     void closeWindowSignal();
 
 public slots:
+    void qPageLoadStartedSlot()
+    {
+        // A new document has no state of the script queues:
+        scriptQueueFunction = false;
+        lastQueueStatus.clear();
+        lastPageQueueStatus.clear();
+
+        QTraceRecorder::instance()->qBegin(
+                    "page", "page load",
+                    QString::number((quintptr) this, 16));
+    }
+
     void qPageLoadedSlot(bool ok)
     {
+        QJsonObject loadTraceArguments;
+        loadTraceArguments["url"] = QPage::mainFrame()->url().toString();
+        loadTraceArguments["ok"] = ok;
+
+        QTraceRecorder::instance()->qEnd(
+                    "page", "page load",
+                    QString::number((quintptr) this, 16),
+                    loadTraceArguments);
+
         if (ok) {
             if (QPage::mainFrame()->url().scheme() == "file") {
                 // Inject all browser-specific Javascript:
@@ -57,8 +87,13 @@ public slots:
                         new QFileReader(QString(":/peb.js"));
                 QString pebJavaScript = resourceReader->fileContents;
 
+                qint64 injectionSpan = QTraceRecorder::instance()->qNow();
+
                 mainFrame()->evaluateJavaScript(pebJavaScript);
 
+                QTraceRecorder::instance()->qComplete(
+                            "page", "peb.js injection", injectionSpan);
+
                 // Start getting the page settings:
                 QVariant result = mainFrame()->
                         evaluateJavaScript("peb.getPageSettings()");
@@ -92,6 +127,26 @@ public slots:
         }
     }
 
+    // ==============================
+    // Request statistics:
+    // ==============================
+    void qCollectResourceTimingsSlot()
+    {
+        // Requests to a local HTTP server are recorded from
+        // the Resource Timing entries of its pages:
+        QString localServerBaseUrl =
+                qApp->property("local_server_base_url").toString();
+
+        if (localServerBaseUrl.startsWith("http") and
+                QPage::mainFrame()->url().toString()
+                .startsWith(localServerBaseUrl)) {
+            QVariant result = mainFrame()->evaluateJavaScript(
+                        QRequestStatistics::resourceTimingsJavaScript);
+            QRequestStatistics::instance()->
+                    qRecordResourceTimings(result.toString());
+        }
+    }
+
     // ==============================
     // Page settings:
     // ==============================
@@ -103,6 +158,27 @@ public slots:
         if (!settingsJsonDocument.isEmpty()) {
             QJsonObject settingsJsonObject = settingsJsonDocument.object();
 
+            // Get the maximal number of scripts running for the page:
+            if (settingsJsonObject["maximumScripts"].toInt() > 0) {
+                QScriptScheduler::instance()->qSetPageLimit(
+                            this, settingsJsonObject["maximumScripts"].toInt());
+            }
+
+            // Script lifecycle markers in the performance timeline:
+            if (settingsJsonObject["performanceMarks"].toBool() == true) {
+                performanceMarks = true;
+            }
+
+            // Pages with a scriptQueueFunction get every queue change:
+            scriptQueueFunction =
+                    settingsJsonObject["scriptQueueFunction"].toBool(false);
+
+            // Get the delay in seconds after which
+            // memory caches of a hidden page are released:
+            freezeDelay =
+                    qRound(settingsJsonObject["freezeDelay"].toDouble(0) *
+                           1000);
+
             // Get auto-start scripts:
             QJsonArray autoStartScripts =
                     settingsJsonObject["autoStartScripts"].toArray();
@@ -157,6 +233,10 @@ public slots:
     // ==============================
     void qHandleDialogs(QString dialogObjectName)
     {
+        QStallScope stallScope("QPage::qHandleDialogs");
+
+        QMetrics::instance()->bridgeCalls++;
+
         if (QPage::mainFrame()->url().scheme() == "file") {
             QVariant dialogSettings =
                     mainFrame()->evaluateJavaScript(
@@ -175,6 +255,8 @@ public slots:
 
     void qReadDialogSettings(QJsonObject dialogJsonObject)
     {
+        QStallScope stallScope("QPage::qReadDialogSettings");
+
         QString id = dialogJsonObject["id"].toString();
 
         QString type = dialogJsonObject["type"].toString();
@@ -222,6 +304,9 @@ public slots:
             QString outputInsertionJavaScript =
                     id + ".receiverFunction('" + inodesFormatted + "'); null";
 
+            PEB_PROBE3(page__javascript, (void *) this,
+                       outputInsertionJavaScript.length(), false);
+
             mainFrame()->evaluateJavaScript(outputInsertionJavaScript);
         }
     }
@@ -231,6 +316,10 @@ public slots:
     // ==============================
     void qHandleScripts(QString scriptObjectName)
     {
+        QStallScope stallScope("QPage::qHandleScripts");
+
+        QMetrics::instance()->bridgeCalls++;
+
         if (QPage::mainFrame()->url().scheme() == "file") {
             QVariant scriptSettings =
                     mainFrame()->evaluateJavaScript(
@@ -249,20 +338,72 @@ public slots:
 
     void qScriptStartedCheck(QJsonObject scriptJsonObject)
     {
-        // Start the script if it is not yet started:
-        if (!runningScripts.contains(scriptJsonObject["id"].toString())) {
-            qStartScript(scriptJsonObject);
+        QString scriptId = scriptJsonObject["id"].toString();
+
+        // Periodic scripts are registered when they are first started and
+        // are started again by the periodic scheduler:
+        if (closeRequested == false) {
+            QPeriodicScheduler::instance()->qRegister(this, scriptJsonObject);
         }
 
-        // Feed the script with data if it is already started:
-        if (runningScripts.contains(scriptJsonObject["id"].toString())) {
+        // Feed the script with data if it is already started.
+        // Resident periodic scripts without input data
+        // receive an empty line on every run:
+        if (runningScripts.contains(scriptId)) {
+            QPeriodicJob *periodicJob =
+                    QPeriodicScheduler::instance()->qJob(this, scriptId);
+
+            if (periodicJob != NULL and periodicJob->resident == true and
+                    scriptJsonObject["scriptInput"].toString().length() == 0) {
+                runningScripts.value(scriptId)->qWriteInput("\n");
+            }
+
             qFeedScript(scriptJsonObject);
+            return;
+        }
+
+        // Scripts waiting for a free slot keep their data
+        // until they are started:
+        if (QScriptScheduler::instance()->qAppendInput(
+                    this, scriptId,
+                    scriptJsonObject["scriptInput"].toString())) {
+            return;
         }
+
+        // Start the script as soon as the scheduler allows it:
+        if (closeRequested == false) {
+            QScriptScheduler::instance()->qEnqueue(this, scriptJsonObject);
+        }
+    }
+
+    void qPeriodicTickSlot(QString scriptId)
+    {
+        QPeriodicJob *periodicJob =
+                QPeriodicScheduler::instance()->qJob(this, scriptId);
+
+        // A run of a short-lived periodic script is skipped if
+        // the previous run is still running or waiting in a queue:
+        if (periodicJob != NULL and periodicJob->resident == false and
+                (runningScripts.contains(scriptId) or
+                 QScriptScheduler::instance()->qAppendInput(
+                     this, scriptId, QString()))) {
+            periodicJob->skippedRuns++;
+            return;
+        }
+
+        qHandleScripts(scriptId);
+    }
+
+    void qStartQueuedScript(QJsonObject scriptJsonObject)
+    {
+        qStartScript(scriptJsonObject);
+        qFeedScript(scriptJsonObject);
     }
 
     void qStartScript(QJsonObject scriptJsonObject)
     {
-        QScriptHandler *scriptHandler = new QScriptHandler(scriptJsonObject);
+        QScriptHandler *scriptHandler =
+                new QScriptHandler(scriptJsonObject, this);
 
         QObject::connect(scriptHandler,
                          SIGNAL(displayScriptOutputSignal(QString,
@@ -276,10 +417,38 @@ public slots:
                          this,
                          SLOT(qDisplayScriptErrorsSlot(QString)));
 
-        QObject::connect(scriptHandler, SIGNAL(scriptFinishedSignal(QString)),
-                         this, SLOT(qScriptFinishedSlot(QString)));
+        QObject::connect(scriptHandler,
+                         SIGNAL(scriptFinishedSignal(QString, QJsonObject)),
+                         this,
+                         SLOT(qScriptFinishedSlot(QString, QJsonObject)));
+
+        QObject::connect(scriptHandler, SIGNAL(scriptIdleSignal(bool)),
+                         this, SLOT(qScriptIdleSlot(bool)));
+
+        if (background == true) {
+            scriptHandler->qSetBackground(true);
+        }
 
         runningScripts.insert(scriptJsonObject["id"].toString(), scriptHandler);
+
+        qScriptMark("peb.scriptMark('" + scriptJsonObject["id"].toString() +
+                    "', 'spawn');");
+    }
+
+    // ==============================
+    // Script lifecycle markers:
+    // Spawn, first output, every output batch and exit of
+    // every script are visible in the performance timeline of DevTools.
+    // ==============================
+    void qScriptMark(QString markJavaScript)
+    {
+        if (performanceMarks == true and
+                QPage::mainFrame()->url().scheme() == "file") {
+            mainFrame()->evaluateJavaScript(
+                        "if (typeof peb !== 'undefined' && " +
+                        QString("typeof peb.scriptMark === 'function') {") +
+                        markJavaScript + "} null");
+        }
     }
 
     void qFeedScript(QJsonObject scriptJsonObject)
@@ -292,19 +461,174 @@ public slots:
         if (scriptInput.length() > 0) {
             QScriptHandler *handler =
                     runningScripts.value(scriptJsonObject["id"].toString());
-            if (handler->scriptProcess.isOpen()) {
-                handler->scriptProcess.write(scriptInput.toUtf8());
-                handler->scriptProcess.write(QString("\n").toLatin1());
+            handler->qWriteInput(scriptInput.toUtf8() + "\n");
+        }
+    }
+
+    void qScriptQueueChangedSlot()
+    {
+        // The state of the script queues is available to the page as
+        // peb.scriptQueue and is passed to
+        // the optional pebSettings.scriptQueueFunction.
+        // Only changed states are pushed and pages without
+        // a scriptQueueFunction get only changes of their own scripts:
+        if (QPage::mainFrame()->url().scheme() == "file") {
+            QJsonObject status = QScriptScheduler::instance()->qStatus(this);
+
+            QByteArray statusJson =
+                    QJsonDocument(status).toJson(QJsonDocument::Compact);
+
+            QJsonObject pageStatus;
+            pageStatus["pageRunning"] = status["pageRunning"];
+            pageStatus["pageQueued"] = status["pageQueued"];
+            pageStatus["pageMaximum"] = status["pageMaximum"];
+
+            QByteArray pageStatusJson =
+                    QJsonDocument(pageStatus).toJson(QJsonDocument::Compact);
+
+            if (statusJson == lastQueueStatus or
+                    (scriptQueueFunction == false and
+                     pageStatusJson == lastPageQueueStatus)) {
+                return;
             }
+
+            lastQueueStatus = statusJson;
+            lastPageQueueStatus = pageStatusJson;
+
+            QString scriptQueueJavaScript =
+                    "if (typeof peb !== 'undefined') {" +
+                    QString("peb.scriptQueue = ") +
+                    QString::fromUtf8(statusJson) +
+                    ";" +
+                    "if (typeof pebSettings !== 'undefined' && " +
+                    "typeof pebSettings.scriptQueueFunction === " +
+                    "'function') {" +
+                    "pebSettings.scriptQueueFunction(peb.scriptQueue);" +
+                    "}} null";
+
+            mainFrame()->evaluateJavaScript(scriptQueueJavaScript);
+        }
+    }
+
+    void qBackgroundChangedSlot(bool windowInBackground)
+    {
+        // Every script follows its own background policy:
+        background = windowInBackground;
+
+        foreach (QScriptHandler *handler, runningScripts.values()) {
+            handler->qSetBackground(background);
+        }
+
+        // Memory caches are released after the freeze delay of a hidden page:
+        if (background == true and freezeDelay > 0) {
+            lifecycleTimer->start(freezeDelay);
+        }
+
+        if (background == false) {
+            lifecycleTimer->stop();
+        }
+    }
+
+    // ==============================
+    // Page lifecycle:
+    // QtWebKit pages can not be frozen or discarded,
+    // but their memory caches can be released.
+    // ==============================
+    void qLifecycleTimerSlot()
+    {
+        QWebSettings::clearMemoryCaches();
+    }
+
+    void qCancelScript(QString scriptId)
+    {
+        QMetrics::instance()->bridgeCalls++;
+
+        // A running script is killed together with its process group and
+        // frees its slot when it exits. A waiting script is never started.
+        QPeriodicScheduler::instance()->qUnregister(this, scriptId);
+
+        if (runningScripts.contains(scriptId)) {
+            runningScripts.value(scriptId)->qCancelSlot();
+        } else {
+            QScriptScheduler::instance()->qCancel(this, scriptId);
+        }
+    }
+
+    // ==============================
+    // Resource accounting:
+    // Statistics of running and finished scripts are
+    // delivered to the peb.stats() callbacks of the page.
+    // ==============================
+    void qScriptStats(QString scriptId)
+    {
+        QMetrics::instance()->bridgeCalls++;
+
+        QJsonObject stats;
+
+        if (runningScripts.contains(scriptId)) {
+            stats = runningScripts.value(scriptId)->qStats();
+        } else {
+            stats["id"] = scriptId;
+            stats["state"] = "unknown";
+
+            QJsonArray queuedScripts = QScriptScheduler::instance()->
+                    qStatus(this).value("pageQueued").toArray();
+
+            if (queuedScripts.contains(QJsonValue(scriptId))) {
+                stats["state"] = "queued";
+            }
+        }
+
+        qSendScriptStats(scriptId, stats);
+    }
+
+    void qSendScriptStats(QString scriptId, QJsonObject stats)
+    {
+        if (QPage::mainFrame()->url().scheme() == "file") {
+            QString statsJavaScript =
+                    "if (typeof peb !== 'undefined' && " +
+                    QString("typeof peb.receiveStats === 'function') {") +
+                    "peb.receiveStats('" + scriptId + "', " +
+                    QJsonDocument(stats).toJson(QJsonDocument::Compact) +
+                    ");} null";
+
+            PEB_PROBE3(page__javascript, (void *) this,
+                       statsJavaScript.length(), false);
+
+            mainFrame()->evaluateJavaScript(statsJavaScript);
         }
     }
 
     void qDisplayScriptOutputSlot(QString id, QString output)
     {
+        QStallScope stallScope("QPage::qDisplayScriptOutputSlot");
+
         if (QPage::mainFrame()->url().scheme() == "file") {
             QString outputInsertionJavaScript =
                     id + ".stdoutFunction('" + output + "'); null";
 
+            QScriptHandler *handler = runningScripts.value(id);
+
+            if (performanceMarks == true and handler != NULL) {
+                if (handler->deliveries == 1) {
+                    qScriptMark("peb.scriptMark('" + id +
+                                "', 'first output');");
+                }
+
+                qScriptMark("peb.scriptOutputStart('" + id + "', " +
+                            QString::number(output.toUtf8().size()) + ", " +
+                            QString::number(handler->outputTime) + ");");
+
+                outputInsertionJavaScript.append(
+                            "; if (typeof peb !== 'undefined' && " +
+                            QString("typeof peb.scriptOutputEnd === ") +
+                            "'function') {peb.scriptOutputEnd('" + id +
+                            "');} null");
+            }
+
+            PEB_PROBE3(page__javascript, (void *) this,
+                       outputInsertionJavaScript.length(), false);
+
             mainFrame()->evaluateJavaScript(outputInsertionJavaScript);
         }
     }
@@ -321,17 +645,35 @@ public slots:
                 QString perlScriptErrorsMessage =
                         "console.log('" + errors + "'); null";
 
+                PEB_PROBE3(page__javascript, (void *) this,
+                           perlScriptErrorsMessage.length(), false);
+
                 mainFrame()->evaluateJavaScript(perlScriptErrorsMessage);
             }
         }
     }
 
-    void qScriptFinishedSlot(QString scriptId)
+    void qScriptIdleSlot(bool idle)
     {
-        runningScripts.remove(scriptId);
+        QScriptScheduler::instance()->qScriptIdle(this, sender(), idle);
+    }
+
+    void qScriptFinishedSlot(QString scriptId, QJsonObject stats)
+    {
+        QScriptHandler *handler = runningScripts.take(scriptId);
+        if (handler != NULL) {
+            qScriptMark("peb.scriptExit('" + scriptId + "', " +
+                        QString::number(
+                            handler->scriptProcess.exitCode()) + ");");
+            qSendScriptStats(scriptId, stats);
+
+            handler->deleteLater();
+            QScriptScheduler::instance()->qScriptFinished(this,
+                                                          handler->idle);
+        }
 
         if (closeRequested == true and runningScripts.isEmpty()) {
-            emit closeWindowSignal();
+            qScriptsClosed();
         }
     }
 
@@ -349,6 +691,8 @@ public slots:
     // ==============================
     void qStartWindowClosingSlot()
     {
+        QStallScope stallScope("QPage::qStartWindowClosingSlot");
+
         if (QPage::mainFrame()->url().scheme() == "file") {
             QVariant jsResult =
                     mainFrame()->evaluateJavaScript(
@@ -365,73 +709,56 @@ public slots:
         jsCloseDecision = jsResult.toBool();
 
         if (jsCloseDecision == true) {
-            if (!runningScripts.isEmpty()){
-                qCloseAllScriptsSlot();
-            } else {
-                emit closeWindowSignal();
-            }
+            qCloseAllScriptsSlot();
         }
     }
 
     void qCloseAllScriptsSlot()
     {
-        closeRequested = true;
+        if (closeRequested == true) {
+            return;
+        }
 
-        if (!runningScripts.isEmpty()) {
-            QHash<QString, QScriptHandler*>::iterator iterator;
-            for (iterator = runningScripts.begin();
-                 iterator != runningScripts.end();
-                 ++iterator) {
-                QScriptHandler *handler = iterator.value();
-
-                if (handler->scriptProcess.isOpen()) {
-#ifndef Q_OS_WIN
-                    handler->scriptProcess.terminate();
-#endif
+        closeRequested = true;
+        emit closingScriptsSignal();
 
-#ifdef Q_OS_WIN
-                    handler->scriptProcess.kill();
-                    runningScripts.remove(iterator.key());
-#endif
-                }
+        // Waiting scripts are never started:
+        QScriptScheduler::instance()->qRemovePage(this);
+        QPeriodicScheduler::instance()->qRemovePage(this);
 
-                if (!handler->scriptProcess.isOpen()) {
-                    runningScripts.remove(iterator.key());
-                }
-            }
+        if (runningScripts.isEmpty()) {
+            qScriptsClosed();
+            return;
         }
 
-#ifndef Q_OS_WIN
-        if (!runningScripts.isEmpty()) {
-            int maximumTimeMilliseconds = 3000;
-            QTimer::singleShot(maximumTimeMilliseconds,
-                               this, SLOT(qScriptsTimeoutSlot()));
+        // All scripts and their child processes are signalled at once.
+        // The window is closed as soon as the last script has finished.
+        foreach (QScriptHandler *handler, runningScripts.values()) {
+            handler->scriptProcess.terminateProcessGroup();
         }
-#endif
 
-        if (runningScripts.isEmpty()) {
-            emit closeWindowSignal();
-        }
+        // Scripts still running after the grace period are killed:
+        QTimer::singleShot(scriptsGracePeriod,
+                           this, SLOT(qScriptsTimeoutSlot()));
     }
 
     void qScriptsTimeoutSlot()
     {
-#ifndef Q_OS_WIN
         if (!runningScripts.isEmpty()) {
-            QHash<QString, QScriptHandler*>::iterator iterator;
-            for (iterator = runningScripts.begin();
-                 iterator != runningScripts.end();
-                 ++iterator) {
-                QScriptHandler *handler = iterator.value();
-
-                if (handler->scriptProcess.isOpen()) {
-                    handler->scriptProcess.kill();
-                }
+            foreach (QScriptHandler *handler, runningScripts.values()) {
+                handler->scriptProcess.killProcessGroup();
             }
+
+            qScriptsClosed();
         }
+    }
 
-        emit closeWindowSignal();
-#endif
+    void qScriptsClosed()
+    {
+        if (scriptsClosed == false) {
+            scriptsClosed = true;
+            emit closeWindowSignal();
+        }
     }
 
 protected:
@@ -442,7 +769,25 @@ protected:
                                  const QNetworkRequest &request,
                                  QWebPage::NavigationType navigationType)
     {
-        Q_UNUSED(frame);
+        PEB_PROBE3(page__navigation, (void *) this,
+                   (int) navigationType, frame == mainFrame());
+
+        // Request statistics of the local server:
+        if ((request.url().scheme() == "file" or
+             request.url().host() == "localhost") and
+                navigationType == QWebPage::NavigationTypeLinkClicked and
+                request.url().fileName() == "request-statistics.function") {
+            qCollectResourceTimingsSlot();
+
+            QMessageBox statisticsBox;
+            statisticsBox.setWindowTitle("Request Statistics");
+            statisticsBox.setText(
+                        QRequestStatistics::instance()->qHtmlReport());
+            statisticsBox.setDefaultButton(QMessageBox::Ok);
+            statisticsBox.exec();
+
+            return false;
+        }
 
         // Handle filesystem dialogs:
         if ((request.url().scheme() == "file" or
@@ -455,6 +800,24 @@ protected:
 
         // Handle local Perl scripts and functional pseudo filenames:
         if (request.url().scheme() == "file") {
+            // Submitting and clicking special pseudo links
+            // cancels local Perl scripts:
+            if ((navigationType == QWebPage::NavigationTypeFormSubmitted or
+                 navigationType == QWebPage::NavigationTypeLinkClicked) and
+                    request.url().fileName().contains(".cancel")) {
+                qCancelScript(request.url().fileName().replace(".cancel", ""));
+                return false;
+            }
+
+            // Submitting and clicking special pseudo links
+            // requests statistics of local Perl scripts:
+            if ((navigationType == QWebPage::NavigationTypeFormSubmitted or
+                 navigationType == QWebPage::NavigationTypeLinkClicked) and
+                    request.url().fileName().contains(".stats")) {
+                qScriptStats(request.url().fileName().replace(".stats", ""));
+                return false;
+            }
+
             // Submitting special forms is a method to start local Perl scripts:
             if (navigationType == QWebPage::NavigationTypeFormSubmitted and
                     request.url().fileName().contains(".script")) {
@@ -515,6 +878,8 @@ protected:
     {
         Q_UNUSED(frame);
 
+        QStallScope stallScope("QPage::javaScriptAlert");
+
         QMessageBox javaScriptAlertMessageBox (qApp->activeWindow());
         javaScriptAlertMessageBox.setWindowModality(Qt::WindowModal);
         javaScriptAlertMessageBox.setWindowTitle(title);
@@ -531,6 +896,8 @@ protected:
     {
         Q_UNUSED(frame);
 
+        QStallScope stallScope("QPage::javaScriptConfirm");
+
         QMessageBox javaScriptConfirmMessageBox (qApp->activeWindow());
         javaScriptConfirmMessageBox.setWindowModality(Qt::WindowModal);
         javaScriptConfirmMessageBox.setWindowTitle(title);
@@ -553,6 +920,8 @@ protected:
     {
         Q_UNUSED(frame);
 
+        QStallScope stallScope("QPage::javaScriptPrompt");
+
         bool ok = false;
 
         QInputDialog dialog;
@@ -582,9 +951,20 @@ private:
     QString noLabel;
 
     bool closeRequested;
+    bool scriptsClosed;
+    bool background;
+    bool performanceMarks;
+    bool scriptQueueFunction;
+    QByteArray lastQueueStatus;
+    QByteArray lastPageQueueStatus;
+    int scriptsGracePeriod;
+
+    QTimer *lifecycleTimer;
+    int freezeDelay;
 
 public:
-    QPage();
+    explicit QPage(QObject *parent = 0);
+    ~QPage();
     QHash<QString, QScriptHandler*> runningScripts;
 };
 
@@ -19,6 +19,8 @@
 
 #include <webkit-view.h>
 
+#include "webkit-main-window.h"
+
 // ==============================
 // VIEW CLASS CONSTRUCTOR:
 // (QTWEBKIT VERSION)
@@ -45,8 +47,8 @@ QViewWidget::QViewWidget()
     QObject::connect(qWebInspestorShortcut, SIGNAL(activated()),
                      this, SLOT(qStartQWebInspector()));
 
-    // Starting of a QPage instance:
-    mainPage = new QPage();
+    // Starting of a QPage instance deleted together with its window:
+    mainPage = new QPage(this);
 
     // Signal and slot for changing window title:
     QObject::connect(mainPage, SIGNAL(pageLoadedSignal()),
@@ -62,3 +64,28 @@ QViewWidget::QViewWidget()
     // Installing of the started QPage instance:
     setPage(mainPage);
 }
+
+// ==============================
+// New windows:
+// ==============================
+QWebView *QViewWidget::createWindow(QWebPage::WebWindowType type)
+{
+    Q_UNUSED(type);
+
+    // Only local pages are allowed to open new windows.
+    // Remote pages can not spawn windows of the application:
+    QUrl openerUrl = page()->mainFrame()->url();
+    if (openerUrl.scheme() != "file" and
+            openerUrl.host() != "localhost" and
+            openerUrl.scheme() != "local-server") {
+        return NULL;
+    }
+
+    // Windows opened by window.open() or peb.openWindow() share
+    // the browser engine, its caches and the script schedulers
+    // with all other windows of the application:
+    QMainBrowserWindow *window = new QMainBrowserWindow();
+    window->showMaximized();
+
+    return window->webViewWidget;
+}
@@ -181,13 +181,16 @@ public slots:
     // ==============================
     void qCloseWindowSlot()
     {
-        qApp->setProperty("windowCloseRequested", true);
+        this->parentWidget()->setProperty("windowCloseRequested", true);
         this->parentWidget()->close();
     }
 
 public:
     QViewWidget();
 
+protected:
+    QWebView *createWindow(QWebPage::WebWindowType type) override;
+
 private:
     QPage *mainPage;
 };